@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+#include <string_view>
+
+#include <aot/transpiler.h>
+#include <diagnostic/diagnostic.h>
+#include <env/interpreter.h>
+#include <env/optimizer.h>
+#include <env/resolver.h>
+#include <env/scalar.h>
+#include <parser/parser.h>
+#include <scanner/scanner.h>
+
+int main(int argc, char* argv[]) {
+    // Compiles a script into a native executable, by way of C++ linked
+    // against the runtime. --emit-cpp keeps the C++ source.
+    std::filesystem::path script;
+    std::filesystem::path output;
+    std::filesystem::path source;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (arg == "--emit-cpp" && i + 1 < argc) {
+            source = argv[++i];
+        } else if (script.empty() && !arg.starts_with("-")) {
+            script = arg;
+        } else {
+            script.clear();
+            break;
+        }
+    }
+    if (script.empty() || output.empty()) {
+        std::print("Usage: cpplox_aot script -o executable [--emit-cpp file]\n");
+        return 64;
+    }
+
+    std::ifstream file(script);
+    if (!file.is_open()) {
+        std::print(stderr, "Could not open {}.\n", script.string());
+        return 66;
+    }
+    std::string program{ std::istreambuf_iterator<char>(file), {} };
+
+    cpplox::Diagnostic diagnostic;
+    cpplox::Scanner scanner(program, diagnostic);
+    auto tokens = scanner.scanTokens();
+    if (diagnostic.hadError()) {
+        return 65;
+    }
+    cpplox::Parser parser(tokens, diagnostic);
+    auto stmts = parser.parse();
+    if (diagnostic.hadError() || !stmts.has_value()) {
+        return 65;
+    }
+    cpplox::Interpreter interpreter(diagnostic);
+    cpplox::ScalarReplacement().replace(*stmts);
+    cpplox::Resolver resolver(interpreter);
+    resolver.resolve(*stmts);
+    if (diagnostic.hadError()) {
+        return 65;
+    }
+    cpplox::Optimizer(interpreter).optimize(*stmts);
+
+    bool keepSource = !source.empty();
+    if (!keepSource) {
+        source = output;
+        source += ".cpp";
+    }
+    {
+        std::ofstream out(source);
+        out << cpplox::Transpiler(interpreter).transpile(*stmts, script.filename().string());
+        if (!out) {
+            std::print(stderr, "Could not write {}.\n", source.string());
+            return 74;
+        }
+    }
+
+    // The compiler and flags cpplox was built with, see CMakeLists.txt
+    std::string command = std::format("{} {} -o \"{}\" \"{}\" {}", AOT_COMPILER, AOT_FLAGS, output.string(), source.string(), AOT_LIBRARIES);
+    int status = std::system(command.c_str());
+    if (!keepSource) {
+        std::filesystem::remove(source);
+    }
+    if (status != 0) {
+        std::print(stderr, "Compiling {} failed.\n", source.string());
+        return 70;
+    }
+    return 0;
+}
\ No newline at end of file
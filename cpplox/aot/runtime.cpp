@@ -0,0 +1,285 @@
+#include <aot/runtime.h>
+
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <print>
+#include <unordered_map>
+
+#include <diagnostic/diagnostic.h>
+#include <env/interpreter.h>
+#include <env/number.h>
+#include <env/object.h>
+#include <scanner/token.h>
+#include <util/scope_guard.h>
+
+namespace cpplox {
+
+namespace aot {
+
+namespace {
+
+TokenType tokenType(Op op) {
+    switch (op) {
+        case Op::Plus: return TokenType::PLUS;
+        case Op::Minus: return TokenType::MINUS;
+        case Op::Star: return TokenType::STAR;
+        case Op::Slash: return TokenType::SLASH;
+        case Op::Greater: return TokenType::GREATER;
+        case Op::GreaterEqual: return TokenType::GREATER_EQUAL;
+        case Op::Less: return TokenType::LESS;
+        case Op::LessEqual: return TokenType::LESS_EQUAL;
+        case Op::EqualEqual: return TokenType::EQUAL_EQUAL;
+        case Op::BangEqual: return TokenType::BANG_EQUAL;
+    }
+    std::unreachable();
+}
+
+// Functions are created with a declaration to name them and count their
+// parameters. Compiled ones get a stand-in with an empty body, which is never
+// run: their body is the FunctionInfo's.
+const FunctionStatement& declaration(const FunctionInfo& function) {
+    static std::unordered_map<const FunctionInfo*, std::unique_ptr<FunctionStatement>> declarations;
+    auto& stmt = declarations[&function];
+    if (!stmt) {
+        std::vector<Token> params;
+        for (const char* param : function.params) {
+            params.push_back(Runtime::token(param, function.line));
+        }
+        stmt = std::make_unique<FunctionStatement>(Runtime::token(function.name, function.line), std::move(params), BlockStatement(std::vector<Statement>{}));
+    }
+    return *stmt;
+}
+
+}
+
+int Runtime::run(void (*program)(Interpreter&)) {
+    Diagnostic diagnostic;
+    {
+        Interpreter interpreter(diagnostic, std::cout);
+        try {
+            program(interpreter);
+        } catch (const RuntimeError& e) {
+            // no-op
+        }
+    }
+    return diagnostic.hadError() ? 65 : 0;
+}
+
+const Token& Runtime::token(const char* lexeme, int line) {
+    static std::deque<Token> tokens;
+    return tokens.emplace_back(TokenType::IDENTIFIER, lexeme, std::nullopt, line);
+}
+
+Object& Runtime::local(Interpreter& i, size_t depth, const Token& name) {
+    return i.env_->getAt(depth, name);
+}
+
+Object Runtime::global(Interpreter&, const Token& name) {
+    return Interpreter::globals_.get(name);
+}
+
+void Runtime::assignLocal(Interpreter& i, size_t depth, const Token& name, const Object& value) {
+    i.env_->assignAt(depth, name, value);
+}
+
+void Runtime::assignGlobal(Interpreter&, const Token& name, const Object& value) {
+    Interpreter::globals_.assign(name, value);
+}
+
+void Runtime::define(Interpreter& i, const Token& name, Object value) {
+    i.env_->define(name.lexeme(), std::move(value));
+}
+
+Object Runtime::generic(Interpreter& i, Op op, int line, const Object& left, const Object& right) {
+    return i.binaryGeneric(tokenType(op), line, left, right);
+}
+
+Object Runtime::checkNumber(Interpreter& i, int line, const Object& operand) {
+    i.checkNumberOperands(line, operand);
+    std::unreachable();
+}
+
+// See Interpreter::operator()(const LocalIncrementExpr&)
+Object Runtime::increment(Interpreter& i, size_t depth, const Token& name, bool add, double step, int line) {
+    Object& object = i.env_->getAt(depth, name);
+    if (auto* integer = std::get_if<int64_t>(&object)) {
+        cpplox::increment(object, *integer, add, step);
+        return object;
+    }
+    if (auto* number = std::get_if<double>(&object)) {
+        *number = add ? *number + step : *number - step;
+        return object;
+    }
+    return i.binaryGeneric(add ? TokenType::PLUS : TokenType::MINUS, line, object, step);
+}
+
+Object Runtime::call(Interpreter& i, const Object& callee, std::vector<Object> arguments, const Token& paren) {
+    return i.callValue(callee, std::move(arguments), paren);
+}
+
+Object Runtime::get(Interpreter& i, const Object& object, const Token& name) {
+    if (auto* instance = std::get_if<InstancePtr>(&object)) {
+        if (auto ret = (*instance)->get(name)) {
+            return *ret;
+        }
+        i.error(name, "Undefined property '" + name.lexeme() + "'.");
+        throw RuntimeError();
+    }
+    i.error(name, "Only instances have properties.");
+    throw RuntimeError();
+}
+
+void Runtime::checkFields(Interpreter& i, const Object& object, const Token& name) {
+    if (!std::holds_alternative<InstancePtr>(object)) {
+        i.error(name, "Only instances have fields.");
+        throw RuntimeError();
+    }
+}
+
+Object Runtime::set(const Object& object, const Token& name, Object value) {
+    std::get<InstancePtr>(object)->set(name, value);
+    return value;
+}
+
+Object Runtime::lookUp(Interpreter& i, const Object& object, const Token& name, FunctionPtr& method) {
+    auto* instance = std::get_if<InstancePtr>(&object);
+    if (!instance) {
+        i.error(name, "Only instances have properties.");
+        throw RuntimeError();
+    }
+
+    // Fields shadow methods.
+    if (auto it = (*instance)->fields_.find(name.lexeme()); it != (*instance)->fields_.end()) {
+        return it->second;
+    }
+    method = (*instance)->class_->findMethod(name.lexeme());
+    if (!method) {
+        i.error(name, "Undefined property '" + name.lexeme() + "'.");
+        throw RuntimeError();
+    }
+    return nullptr;
+}
+
+Object Runtime::invoke(Interpreter& i, const Object& object, const Object& field, const FunctionPtr& method, std::vector<Object> arguments, const Token& paren) {
+    if (!method) {
+        return i.callValue(field, std::move(arguments), paren);
+    }
+    if (arguments.size() != method->arity()) {
+        i.error(paren, std::format("Expected {} arguments but got {}.", method->arity(), arguments.size()));
+        throw RuntimeError();
+    }
+    return method->invoke(&i, std::get<InstancePtr>(object), std::move(arguments));
+}
+
+Object Runtime::super(Interpreter& i, size_t superDepth, size_t thisDepth, const Token& method) {
+    auto superclass = i.env_->getAt(superDepth, "super");
+    auto instance = i.env_->getAt(thisDepth, "this");
+    auto function = std::get<ClassPtr>(superclass)->findMethod(method.lexeme());
+    if (!function) {
+        i.error(method, "Undefined property '" + method.lexeme() + "'.");
+        throw RuntimeError();
+    }
+    return function->bind(std::get<InstancePtr>(instance));
+}
+
+// See Interpreter::operator()(const ThisGetExpr&)
+Object Runtime::thisGet(Interpreter& i, size_t depth, const Token& name) {
+    auto& instance = std::get<InstancePtr>(i.env_->getAt(depth, "this"));
+    if (auto it = instance->fields_.find(name.lexeme()); it != instance->fields_.end()) {
+        return it->second;
+    }
+    if (auto method = instance->class_->findMethod(name.lexeme())) {
+        return method->bind(instance);
+    }
+    i.error(name, "Undefined property '" + name.lexeme() + "'.");
+    throw RuntimeError();
+}
+
+void Runtime::print(Interpreter& i, const Object& object) {
+    std::print(i.out_, "{}\n", object);
+}
+
+void Runtime::defineFunction(Interpreter& i, const FunctionInfo& function) {
+    const FunctionStatement& stmt = declaration(function);
+    // Declared first so that a recursive function can capture itself.
+    i.env_->define(function.name, {});
+    EnvironmentPtr closure;
+    if (!function.captures.empty()) {
+        closure = Environment::make();
+        for (const auto& [name, distance] : function.captures) {
+            closure->defineUpvalue(name, i.env_->captureAt(distance, name));
+        }
+    }
+    auto created = makeRef<Function>(std::move(closure), stmt, false, function.stackFrame ? FrameKind::Stack : FrameKind::Heap, &function.body);
+    // The JIT compiles declarations, and this one has no body.
+    created->jittable_ = false;
+    i.env_->define(function.name, std::move(created));
+}
+
+void Runtime::defineClass(Interpreter& i, const ClassInfo& klass, const Object* superclass, const Token* superclassName) {
+    ClassPtr super;
+    if (superclass) {
+        if (!std::holds_alternative<ClassPtr>(*superclass)) {
+            i.error(*superclassName, "Superclass must be a class.");
+            throw RuntimeError();
+        }
+        super = std::get<ClassPtr>(*superclass);
+    }
+    i.env_->define(klass.name, {});
+
+    EnvironmentPtr closure;
+    if (!klass.captures.empty()) {
+        closure = Environment::make();
+        for (const auto& [name, distance] : klass.captures) {
+            closure->defineUpvalue(name, i.env_->captureAt(distance, name));
+        }
+    }
+    if (super) {
+        closure = Environment::make(std::move(closure));
+        closure->define("super", super);
+    }
+
+    std::unordered_map<std::string, FunctionPtr> methods;
+    for (const FunctionInfo* method : klass.methods) {
+        const std::string name = method->name;
+        auto created = makeRef<Function>(closure, declaration(*method), name == "init", method->stackFrame ? FrameKind::Stack : FrameKind::Heap, &method->body);
+        created->jittable_ = false;
+        methods[name] = std::move(created);
+    }
+    i.env_->define(klass.name, makeRef<Class>(klass.name, std::move(methods), std::move(super)));
+}
+
+Runtime::Block::Block(Interpreter& i, Scope scope, EnvironmentPtr env) : i_(i) {
+    switch (scope) {
+        case Scope::None:
+            if (env) {
+                saved_ = std::exchange(i.env_, std::move(env));
+                entered_ = true;
+            }
+            break;
+        case Scope::Stack:
+            saved_ = std::exchange(i.env_, i.frames_.push(env ? std::move(env) : i.env_));
+            entered_ = true;
+            popFrame_ = true;
+            break;
+        case Scope::Fresh:
+            saved_ = std::exchange(i.env_, Environment::make(env ? std::move(env) : i.env_));
+            entered_ = true;
+            break;
+    }
+}
+
+// Restores the environment before the frame it may refer to goes away
+Runtime::Block::~Block() {
+    if (entered_) {
+        i_.env_ = std::move(saved_);
+    }
+    if (popFrame_) {
+        i_.frames_.pop();
+    }
+}
+
+} // aot
+
+} // cpplox
\ No newline at end of file
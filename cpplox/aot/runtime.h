@@ -0,0 +1,155 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <env/fwd.h>
+#include <env/number.h>
+
+namespace cpplox {
+
+class Token;
+
+namespace aot {
+
+// Operators of BinaryExpr
+enum class Op {
+    Plus,
+    Minus,
+    Star,
+    Slash,
+    Greater,
+    GreaterEqual,
+    Less,
+    LessEqual,
+    EqualEqual,
+    BangEqual,
+};
+
+// How a block sets up its environment, as BlockScope
+enum class Scope {
+    None,
+    Fresh,
+    Stack,
+};
+
+// A function or method declaration, with its body compiled to C++
+struct FunctionInfo {
+    const char* name;
+    int line;
+    std::vector<const char*> params;
+    bool stackFrame;
+    // Variables the function captures, and how many scopes up they are
+    std::vector<std::pair<const char*, size_t>> captures;
+    BlockCode body;
+};
+
+struct ClassInfo {
+    const char* name;
+    int line;
+    std::vector<std::pair<const char*, size_t>> captures;
+    std::vector<const FunctionInfo*> methods;
+};
+
+// What the C++ emitted by cpplox_aot calls into. Compiled programs run on an
+// Interpreter's environments and object model, and so keep its semantics and
+// error messages, but never walk an AST: the resolver's decisions are baked
+// into the calls, and declarations only exist as the tables above.
+struct Runtime {
+    // Runs the top-level code, returning the exit code cpplox_run would
+    static int run(void (*program)(Interpreter&));
+
+    // Names and error positions, kept for the whole run
+    static const Token& token(const char* lexeme, int line);
+
+    static Object& local(Interpreter& i, size_t depth, const Token& name);
+    static Object global(Interpreter& i, const Token& name);
+    static void assignLocal(Interpreter& i, size_t depth, const Token& name, const Object& value);
+    static void assignGlobal(Interpreter& i, const Token& name, const Object& value);
+    static void define(Interpreter& i, const Token& name, Object value);
+
+    static bool truthy(const Object& object) {
+        if (auto* b = std::get_if<bool>(&object)) {
+            return *b;
+        }
+        return !std::holds_alternative<std::nullptr_t>(object);
+    }
+
+    // Numbers are handled inline, where `op` is a constant
+    static Object binary(Interpreter& i, Op op, int line, const Object& left, const Object& right) {
+        if (auto* l = std::get_if<double>(&left), *r = std::get_if<double>(&right); l && r) {
+            switch (op) {
+                case Op::Plus: return *l + *r;
+                case Op::Minus: return *l - *r;
+                case Op::Star: return *l * *r;
+                case Op::Slash: return *l / *r;
+                case Op::Greater: return *l > *r;
+                case Op::GreaterEqual: return *l >= *r;
+                case Op::Less: return *l < *r;
+                case Op::LessEqual: return *l <= *r;
+                case Op::EqualEqual: return *l == *r;
+                case Op::BangEqual: return *l != *r;
+            }
+        }
+        return generic(i, op, line, left, right);
+    }
+
+    static Object negate(Interpreter& i, int line, const Object& operand) {
+        if (auto* number = std::get_if<double>(&operand)) {
+            return -*number;
+        }
+        if (isNumber(operand)) {
+            return cpplox::negate(operand);
+        }
+        return checkNumber(i, line, operand);
+    }
+
+    // `name = name + step`, or `- step`, on a local
+    static Object increment(Interpreter& i, size_t depth, const Token& name, bool add, double step, int line);
+
+    static Object call(Interpreter& i, const Object& callee, std::vector<Object> arguments, const Token& paren);
+    static Object get(Interpreter& i, const Object& object, const Token& name);
+    // Reports setting a field on anything but an instance, before the value
+    // is evaluated
+    static void checkFields(Interpreter& i, const Object& object, const Token& name);
+    static Object set(const Object& object, const Token& name, Object value);
+    // An invocation is split in two, as the arguments are evaluated in
+    // between: lookUp() returns the field shadowing the method if there is
+    // one, and the method otherwise.
+    static Object lookUp(Interpreter& i, const Object& object, const Token& name, FunctionPtr& method);
+    static Object invoke(Interpreter& i, const Object& object, const Object& field, const FunctionPtr& method, std::vector<Object> arguments, const Token& paren);
+    static Object super(Interpreter& i, size_t superDepth, size_t thisDepth, const Token& method);
+    static Object thisGet(Interpreter& i, size_t depth, const Token& name);
+
+    static void print(Interpreter& i, const Object& object);
+    static void defineFunction(Interpreter& i, const FunctionInfo& function);
+    // `superclass` is null if the class has none
+    static void defineClass(Interpreter& i, const ClassInfo& klass, const Object* superclass, const Token* superclassName);
+
+    // Runs a block in the environment the resolver chose for it, until
+    // destroyed, as Compiler::compileBlock()
+    class Block {
+    public:
+        Block(Interpreter& i, Scope scope, EnvironmentPtr env);
+        ~Block();
+
+        Block(const Block&) = delete;
+        Block& operator=(const Block&) = delete;
+
+    private:
+        Interpreter& i_;
+        bool entered_ = false;
+        bool popFrame_ = false;
+        EnvironmentPtr saved_;
+    };
+
+private:
+    static Object generic(Interpreter& i, Op op, int line, const Object& left, const Object& right);
+    [[noreturn]] static Object checkNumber(Interpreter& i, int line, const Object& operand);
+};
+
+} // aot
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <driver/driver.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cpplox;
+
+namespace {
+
+// Runs a command, returning what it printed
+std::string output(const std::string& command) {
+    std::string out;
+    FILE* pipe = popen(command.c_str(), "r");
+    REQUIRE(pipe);
+    char buffer[4096];
+    while (size_t n = fread(buffer, 1, sizeof(buffer), pipe)) {
+        out.append(buffer, n);
+    }
+    REQUIRE(pclose(pipe) == 0);
+    return out;
+}
+
+}
+
+TEST_CASE("AotSamples") {
+    for (const auto& entry : std::filesystem::directory_iterator(SAMPLE_DIR)) {
+        INFO(entry.path().filename().string());
+        std::stringstream expected;
+        InterpreterDriver driver(expected);
+        driver.runScript(entry.path());
+
+        std::string executable = std::format("{}/{}", WORK_DIR, entry.path().stem().string());
+        REQUIRE(std::system(std::format("\"{}\" \"{}\" -o \"{}\"", AOT, entry.path().string(), executable).c_str()) == 0);
+        CHECK(output(std::format("\"{}\"", executable)) == expected.str());
+    }
+}
+
+TEST_CASE("AotRuntimeError") {
+    std::string script = std::format("{}/error.lox", WORK_DIR);
+    {
+        std::ofstream out(script);
+        out << "print 1;\nprint -\"a\";\nprint 2;\n";
+    }
+    std::string executable = std::format("{}/error", WORK_DIR);
+    REQUIRE(std::system(std::format("\"{}\" \"{}\" -o \"{}\"", AOT, script, executable).c_str()) == 0);
+    // Exits as cpplox_run does
+    REQUIRE(WEXITSTATUS(std::system(std::format("\"{}\" > /dev/null 2>&1", executable).c_str())) == 65);
+}
\ No newline at end of file
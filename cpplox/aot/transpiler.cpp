@@ -0,0 +1,351 @@
+#include <aot/transpiler.h>
+
+#include <format>
+#include <variant>
+
+#include <util/literal.h>
+
+namespace {
+
+const char* op(cpplox::TokenType type) {
+    switch (type) {
+        case cpplox::TokenType::PLUS: return "Op::Plus";
+        case cpplox::TokenType::MINUS: return "Op::Minus";
+        case cpplox::TokenType::STAR: return "Op::Star";
+        case cpplox::TokenType::SLASH: return "Op::Slash";
+        case cpplox::TokenType::GREATER: return "Op::Greater";
+        case cpplox::TokenType::GREATER_EQUAL: return "Op::GreaterEqual";
+        case cpplox::TokenType::LESS: return "Op::Less";
+        case cpplox::TokenType::LESS_EQUAL: return "Op::LessEqual";
+        case cpplox::TokenType::EQUAL_EQUAL: return "Op::EqualEqual";
+        case cpplox::TokenType::BANG_EQUAL: return "Op::BangEqual";
+        default:
+            // Unreachable.
+            break;
+    }
+    std::unreachable();
+}
+
+const char* scope(cpplox::BlockScope scope) {
+    switch (scope) {
+        case cpplox::BlockScope::None: return "Scope::None";
+        case cpplox::BlockScope::Stack: return "Scope::Stack";
+        default: return "Scope::Fresh";
+    }
+}
+
+}
+
+namespace cpplox {
+
+std::string Transpiler::transpile(const std::vector<Statement>& stmts, const std::string& source) {
+    std::string program;
+    out_ = &program;
+    indent_ = 1;
+    for (const Statement& stmt : stmts) {
+        emit(stmt);
+    }
+
+    return std::format(
+        "// Generated by cpplox_aot from {}. Do not edit.\n"
+        "#include <aot/runtime.h>\n"
+        "\n"
+        "using namespace cpplox;\n"
+        "using namespace cpplox::aot;\n"
+        "\n"
+        "namespace {{\n"
+        "\n"
+        "{}\n{}\n{}\n{}"
+        "void program(Interpreter& i) {{\n"
+        "{}"
+        "}}\n"
+        "\n"
+        "}}\n"
+        "\n"
+        "int main() {{\n"
+        "    return Runtime::run(program);\n"
+        "}}\n",
+        source, tokens_, declarations_, infos_, bodies_, program);
+}
+
+std::string Transpiler::operator()(const AssignExpr& expr) {
+    std::string value = emit(*expr.object);
+    if (auto depth = interpreter_.resolvedDepth(&expr)) {
+        line(std::format("Runtime::assignLocal(i, {}, {}, {});", *depth, token(expr.name.lexeme(), expr.name.line()), value));
+    } else {
+        line(std::format("Runtime::assignGlobal(i, {}, {});", token(expr.name.lexeme(), expr.name.line()), value));
+    }
+    return value;
+}
+
+std::string Transpiler::operator()(const BinaryExpr& expr) {
+    std::string left = emit(*expr.left);
+    std::string right = emit(*expr.right);
+    return temporary(std::format("Runtime::binary(i, {}, {}, {}, {})", op(expr.op.type()), expr.op.line(), left, right));
+}
+
+std::string Transpiler::operator()(const CallExpr& expr) {
+    std::string callee = emit(*expr.callee);
+    std::string args = arguments(expr.arguments);
+    return temporary(std::format("Runtime::call(i, {}, {}, {})", callee, args, token(expr.paren.lexeme(), expr.paren.line())));
+}
+
+std::string Transpiler::operator()(const GetExpr& expr) {
+    std::string object = emit(*expr.object);
+    return temporary(std::format("Runtime::get(i, {}, {})", object, token(expr.name.lexeme(), expr.name.line())));
+}
+
+std::string Transpiler::operator()(const GroupingExpr& expr) {
+    return emit(*expr.expr);
+}
+
+std::string Transpiler::operator()(const LiteralExpr& expr) {
+    if (!expr.object.has_value()) {
+        return temporary("nullptr");
+    }
+    return temporary(std::visit([]<typename T>(const T & l) {
+        if constexpr (std::is_same_v<T, double>) {
+            return cppNumber(l);
+        } else {
+            return std::format("std::string({}, {})", cppString(l), l.size());
+        }
+    }, *expr.object));
+}
+
+// The right operand is only evaluated if the left one doesn't decide.
+std::string Transpiler::operator()(const LogicalExpr& expr) {
+    std::string result = temporary(emit(*expr.left));
+    line(std::format("if ({}Runtime::truthy({})) {{", expr.op.type() == TokenType::OR ? "!" : "", result));
+    indent_++;
+    std::string right = emit(*expr.right);
+    line(std::format("{} = {};", result, right));
+    indent_--;
+    line("}");
+    return result;
+}
+
+std::string Transpiler::operator()(const SetExpr& expr) {
+    std::string object = emit(*expr.object);
+    std::string name = token(expr.name.lexeme(), expr.name.line());
+    line(std::format("Runtime::checkFields(i, {}, {});", object, name));
+    std::string value = emit(*expr.value);
+    return temporary(std::format("Runtime::set({}, {}, {})", object, name, value));
+}
+
+std::string Transpiler::operator()(const SuperExpr& expr) {
+    size_t superDepth = interpreter_.resolvedDepth(&expr).value_or(0);
+    size_t thisDepth = interpreter_.resolvedDepth(&expr.method).value_or(0);
+    return temporary(std::format("Runtime::super(i, {}, {}, {})", superDepth, thisDepth, token(expr.method.lexeme(), expr.method.line())));
+}
+
+std::string Transpiler::operator()(const ThisExpr& expr) {
+    return lookUpVariable(expr.keyword, &expr);
+}
+
+std::string Transpiler::operator()(const UnaryExpr& expr) {
+    std::string right = emit(*expr.right);
+    if (expr.op.type() == TokenType::BANG) {
+        return temporary(std::format("!Runtime::truthy({})", right));
+    }
+    return temporary(std::format("Runtime::negate(i, {}, {})", expr.op.line(), right));
+}
+
+std::string Transpiler::operator()(const VarExpr& expr) {
+    return lookUpVariable(expr.name, &expr);
+}
+
+std::string Transpiler::operator()(const LocalCompareExpr& expr) {
+    std::string left = temporary(std::format("Runtime::local(i, {}, {})", expr.leftDepth, token(expr.left, expr.line)));
+    std::string right = temporary(std::format("Runtime::local(i, {}, {})", expr.rightDepth, token(expr.right, expr.line)));
+    return temporary(std::format("Runtime::binary(i, {}, {}, {}, {})", op(expr.op), expr.line, left, right));
+}
+
+std::string Transpiler::operator()(const LocalIncrementExpr& expr) {
+    return temporary(std::format("Runtime::increment(i, {}, {}, {}, {}, {})", expr.depth, token(expr.name, expr.line),
+        expr.op == TokenType::PLUS ? "true" : "false", cppNumber(expr.step), expr.line));
+}
+
+std::string Transpiler::operator()(const ThisGetExpr& expr) {
+    return temporary(std::format("Runtime::thisGet(i, {}, {})", expr.depth, token(expr.name, expr.line)));
+}
+
+// The method is looked up before the arguments are evaluated, and their
+// number checked after, as in Interpreter::operator()(const InvokeExpr&).
+std::string Transpiler::operator()(const InvokeExpr& expr) {
+    std::string object = emit(*expr.object);
+    std::string method = std::format("m{}", temporaries_++);
+    line(std::format("FunctionPtr {};", method));
+    std::string field = temporary(std::format("Runtime::lookUp(i, {}, {}, {})", object, token(expr.name.lexeme(), expr.name.line()), method));
+    std::string args = arguments(expr.arguments);
+    return temporary(std::format("Runtime::invoke(i, {}, {}, {}, {}, {})", object, field, method, args, token(expr.paren.lexeme(), expr.paren.line())));
+}
+
+void Transpiler::operator()(const BlockStatement& stmt) {
+    block(stmt);
+}
+
+void Transpiler::operator()(const ClassStatement& stmt) {
+    std::string superclass = "nullptr";
+    std::string superclassName = "nullptr";
+    if (stmt.superclass.has_value()) {
+        superclass = "&" + operator()(*stmt.superclass);
+        superclassName = "&" + token(stmt.superclass->name.lexeme(), stmt.superclass->name.line());
+    }
+
+    std::string methods;
+    for (const FunctionStatement& method : stmt.methods) {
+        methods += (methods.empty() ? " &" : ", &") + function(method);
+    }
+    std::string name = std::format("class{}", functions_++);
+    infos_ += std::format("const ClassInfo {}{{ {}, {}, {}, {{{}{}}} }};\n", name, cppString(stmt.name.lexeme()), stmt.name.line(),
+        captures(&stmt), methods, methods.empty() ? "" : " ");
+    line(std::format("Runtime::defineClass(i, {}, {}, {});", name, superclass, superclassName));
+}
+
+void Transpiler::operator()(const ExprStatement& stmt) {
+    emit(stmt.expr);
+}
+
+void Transpiler::operator()(const FunctionStatement& stmt) {
+    line(std::format("Runtime::defineFunction(i, {});", function(stmt)));
+}
+
+void Transpiler::operator()(const IfStatement& stmt) {
+    std::string condition = emit(stmt.condition);
+    line(std::format("if (Runtime::truthy({})) {{", condition));
+    indent_++;
+    emit(*stmt.thenBranch);
+    indent_--;
+    if (stmt.elseBranch) {
+        line("} else {");
+        indent_++;
+        emit(*stmt.elseBranch);
+        indent_--;
+    }
+    line("}");
+}
+
+void Transpiler::operator()(const PrintStatement& stmt) {
+    line(std::format("Runtime::print(i, {});", emit(stmt.expr)));
+}
+
+void Transpiler::operator()(const ReturnStatement& stmt) {
+    line(std::format("return {};", stmt.value.has_value() ? emit(*stmt.value) : "Object{ nullptr }"));
+}
+
+void Transpiler::operator()(const VarStatement& stmt) {
+    std::string value = stmt.initializer.has_value() ? emit(*stmt.initializer) : temporary("nullptr");
+    line(std::format("Runtime::define(i, {}, {});", token(stmt.name.lexeme(), stmt.name.line()), value));
+}
+
+void Transpiler::operator()(const WhileStatement& stmt) {
+    line("while (true) {");
+    indent_++;
+    std::string condition = emit(stmt.condition);
+    line(std::format("if (!Runtime::truthy({})) {{", condition));
+    line("    break;");
+    line("}");
+    block(*stmt.body);
+    indent_--;
+    line("}");
+}
+
+std::string Transpiler::emit(const Expr& expr) {
+    return std::visit(*this, expr);
+}
+
+void Transpiler::emit(const Statement& stmt) {
+    std::visit(*this, stmt);
+}
+
+void Transpiler::line(const std::string& code) {
+    out_->append(4 * indent_, ' ');
+    *out_ += code;
+    *out_ += '\n';
+}
+
+// Blocks that declare nothing run in the enclosing environment and need no
+// guard.
+void Transpiler::block(const BlockStatement& stmt) {
+    BlockScope blockScope = interpreter_.blockScope(stmt);
+    line("{");
+    indent_++;
+    if (blockScope != BlockScope::None) {
+        line(std::format("Runtime::Block b{}(i, {}, nullptr);", temporaries_++, scope(blockScope)));
+    }
+    for (const Statement& s : stmt.statements) {
+        emit(s);
+    }
+    indent_--;
+    line("}");
+}
+
+std::string Transpiler::temporary(const std::string& value) {
+    std::string name = std::format("t{}", temporaries_++);
+    line(std::format("Object {} = {};", name, value));
+    return name;
+}
+
+std::string Transpiler::arguments(const std::vector<Expr>& arguments) {
+    std::string list = "{";
+    for (const Expr& argument : arguments) {
+        list += (list.size() > 1 ? ", " : " ") + emit(argument);
+    }
+    return list + (list.size() > 1 ? " }" : "}");
+}
+
+std::string Transpiler::lookUpVariable(const Token& name, const void* expr) {
+    if (auto depth = interpreter_.resolvedDepth(expr)) {
+        return temporary(std::format("Runtime::local(i, {}, {})", *depth, token(name.lexeme(), name.line())));
+    }
+    return temporary(std::format("Runtime::global(i, {})", token(name.lexeme(), name.line())));
+}
+
+std::string Transpiler::token(const std::string& lexeme, int line) {
+    auto& name = tokenNames_[{ lexeme, line }];
+    if (name.empty()) {
+        name = std::format("k{}", tokenNames_.size() - 1);
+        tokens_ += std::format("const Token& {} = Runtime::token({}, {});\n", name, cppString(lexeme), line);
+    }
+    return name;
+}
+
+std::string Transpiler::function(const FunctionStatement& stmt) {
+    size_t index = functions_++;
+    std::string body = std::format("body{}", index);
+    std::string signature = std::format("std::optional<Object> {}(Interpreter& i, EnvironmentPtr env)", body);
+    declarations_ += signature + ";\n";
+
+    // Runs in the frame Function::call() set up, see Compiler::compileBlock()
+    std::string code = signature + " {\n";
+    std::string* enclosing = std::exchange(out_, &code);
+    int indent = std::exchange(indent_, 1);
+    line(std::format("Runtime::Block b{}(i, {}, std::move(env));", temporaries_++, scope(interpreter_.blockScope(*stmt.body))));
+    for (const Statement& s : stmt.body->statements) {
+        emit(s);
+    }
+    line("return std::nullopt;");
+    out_ = enclosing;
+    indent_ = indent;
+    code += "}\n\n";
+    bodies_ += code;
+
+    std::string params;
+    for (const Token& param : stmt.params) {
+        params += (params.empty() ? " " : ", ") + cppString(param.lexeme());
+    }
+    std::string name = std::format("function{}", index);
+    infos_ += std::format("const FunctionInfo {}{{ {}, {}, {{{}{}}}, {}, {}, {} }};\n", name, cppString(stmt.name.lexeme()), stmt.name.line(),
+        params, params.empty() ? "" : " ", interpreter_.frameKind(stmt) == FrameKind::Stack ? "true" : "false", captures(&stmt), body);
+    return name;
+}
+
+std::string Transpiler::captures(const void* declaration) {
+    std::string list;
+    for (const auto& [name, distance] : interpreter_.captures(declaration)) {
+        list += std::format("{}{{ {}, {} }}", list.empty() ? " " : ", ", cppString(name), distance);
+    }
+    return "{" + list + (list.empty() ? "}" : " }");
+}
+
+} // cpplox
\ No newline at end of file
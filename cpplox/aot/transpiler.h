@@ -0,0 +1,83 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Ahead-of-time compiler behind cpplox_aot. Turns a resolved program into a
+// C++ translation unit that runs it on aot::Runtime, with scope distances,
+// block scopes, frame kinds and captures taken from the Interpreter it was
+// resolved against. Every expression is evaluated into a temporary of its
+// own, so the emitted code keeps Lox's left-to-right order of evaluation.
+class Transpiler {
+public:
+    Transpiler(const Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    // The program as C++ source, with a main() running it
+    std::string transpile(const std::vector<Statement>& stmts, const std::string& source);
+
+    // Emit the code computing the expression, and return the temporary
+    // holding its value
+    std::string operator()(const AssignExpr& expr);
+    std::string operator()(const BinaryExpr& expr);
+    std::string operator()(const CallExpr& expr);
+    std::string operator()(const GetExpr& expr);
+    std::string operator()(const GroupingExpr& expr);
+    std::string operator()(const LiteralExpr& expr);
+    std::string operator()(const LogicalExpr& expr);
+    std::string operator()(const SetExpr& expr);
+    std::string operator()(const SuperExpr& expr);
+    std::string operator()(const ThisExpr& expr);
+    std::string operator()(const UnaryExpr& expr);
+    std::string operator()(const VarExpr& expr);
+    std::string operator()(const LocalCompareExpr& expr);
+    std::string operator()(const LocalIncrementExpr& expr);
+    std::string operator()(const ThisGetExpr& expr);
+    std::string operator()(const InvokeExpr& expr);
+
+    void operator()(const BlockStatement& stmt);
+    void operator()(const ClassStatement& stmt);
+    void operator()(const ExprStatement& stmt);
+    void operator()(const FunctionStatement& stmt);
+    void operator()(const IfStatement& stmt);
+    void operator()(const PrintStatement& stmt);
+    void operator()(const ReturnStatement& stmt);
+    void operator()(const VarStatement& stmt);
+    void operator()(const WhileStatement& stmt);
+
+private:
+    std::string emit(const Expr& expr);
+    void emit(const Statement& stmt);
+    void line(const std::string& code);
+    void block(const BlockStatement& stmt);
+    std::string temporary(const std::string& value);
+    std::string arguments(const std::vector<Expr>& arguments);
+    std::string lookUpVariable(const Token& name, const void* expr);
+    std::string token(const std::string& lexeme, int line);
+    // Emits the body and FunctionInfo of a declaration, and returns the
+    // FunctionInfo's name
+    std::string function(const FunctionStatement& stmt);
+    std::string captures(const void* declaration);
+
+    const Interpreter& interpreter_;
+    // Sections of the translation unit, in order
+    std::string tokens_;
+    std::string declarations_;
+    std::string infos_;
+    std::string bodies_;
+    // Function being emitted into
+    std::string* out_ = nullptr;
+    int indent_ = 0;
+    size_t temporaries_ = 0;
+    size_t functions_ = 0;
+    std::map<std::pair<std::string, int>, std::string> tokenNames_;
+};
+
+} // cpplox
\ No newline at end of file
@@ -26,4 +26,12 @@ UnaryExpr::UnaryExpr(Token o, Expr r) : op(std::move(o)), right(std::make_unique
 
 VarExpr::VarExpr(Token t) : name(std::move(t)) {}
 
+LocalCompareExpr::LocalCompareExpr(std::string l, size_t ld, TokenType o, std::string r, size_t rd, int line) : left(std::move(l)), leftDepth(ld), op(o), right(std::move(r)), rightDepth(rd), line(line) {}
+
+LocalIncrementExpr::LocalIncrementExpr(std::string n, size_t d, TokenType o, double s, int line) : name(std::move(n)), depth(d), op(o), step(s), line(line) {}
+
+ThisGetExpr::ThisGetExpr(size_t d, std::string n, int line) : depth(d), name(std::move(n)), line(line) {}
+
+InvokeExpr::InvokeExpr(std::unique_ptr<Expr> o, Token n, Token p, std::vector<Expr> a) : object(std::move(o)), name(std::move(n)), paren(std::move(p)), arguments(std::move(a)) {}
+
 } // cpplox
\ No newline at end of file
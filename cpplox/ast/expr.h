@@ -1,14 +1,29 @@
 #pragma once
 
+#include <cstdint>
 #include <format>
 #include <memory>
 #include <variant>
 
 #include <scanner/token.h>
+#include <util/ref.h>
 
 namespace cpplox {
 
-using Expr = std::variant<struct AssignExpr, struct BinaryExpr, struct CallExpr, struct GetExpr, struct GroupingExpr, struct LiteralExpr, struct LogicalExpr, struct SetExpr, struct SuperExpr, struct ThisExpr, struct UnaryExpr, struct VarExpr>;
+// Runtime specialization of a node from the operand types it has seen. Nodes
+// start Uninitialized, are rewritten to a specialized handler after their
+// first evaluation, and fall back to Generic once that handler's guard fails.
+enum class Specialization : uint8_t {
+    Uninitialized,
+    Number,      // operands are doubles
+    String,      // operands are strings
+    Monomorphic, // receiver is always an instance of one class
+    Generic,
+    Proven,      // operands are numbers on every evaluation, as type inference proved
+};
+
+using Expr = std::variant<struct AssignExpr, struct BinaryExpr, struct CallExpr, struct GetExpr, struct GroupingExpr, struct LiteralExpr, struct LogicalExpr, struct SetExpr, struct SuperExpr, struct ThisExpr, struct UnaryExpr, struct VarExpr,
+    struct LocalCompareExpr, struct LocalIncrementExpr, struct ThisGetExpr, struct InvokeExpr>;
 
 struct AssignExpr {
     Token name;
@@ -21,6 +36,7 @@ struct BinaryExpr {
     std::unique_ptr<Expr> left;
     Token op;
     std::unique_ptr<Expr> right;
+    mutable Specialization specialization = Specialization::Uninitialized;
 
     BinaryExpr(Expr l, Token o, Expr r);
 };
@@ -36,6 +52,11 @@ struct CallExpr {
 struct GetExpr {
     std::unique_ptr<Expr> object;
     Token name;
+    mutable Specialization specialization = Specialization::Uninitialized;
+    // Inline cache of a Monomorphic node: the method `name` resolves to on
+    // instances of `cachedClass`
+    mutable Ref<class Class> cachedClass;
+    mutable Ref<class Function> cachedMethod;
 
     GetExpr(Expr o, Token n);
 };
@@ -82,6 +103,7 @@ struct ThisExpr {
 struct UnaryExpr {
     Token op;
     std::unique_ptr<Expr> right;
+    mutable Specialization specialization = Specialization::Uninitialized;
 
     UnaryExpr(Token o, Expr r);
 };
@@ -92,6 +114,54 @@ struct VarExpr {
     VarExpr(Token t);
 };
 
+// Superinstructions. The optimizer fuses common shapes of resolved nodes into
+// these after resolution, so they carry their own scope distances.
+
+// `a < b` with both operands local variables
+struct LocalCompareExpr {
+    std::string left;
+    size_t leftDepth;
+    TokenType op;
+    std::string right;
+    size_t rightDepth;
+    int line;
+
+    LocalCompareExpr(std::string l, size_t ld, TokenType o, std::string r, size_t rd, int line);
+};
+
+// `a = a + 1` with a local variable and a number literal
+struct LocalIncrementExpr {
+    std::string name;
+    size_t depth;
+    TokenType op;
+    double step;
+    int line;
+
+    LocalIncrementExpr(std::string n, size_t d, TokenType o, double s, int line);
+};
+
+// `this.name`
+struct ThisGetExpr {
+    size_t depth;
+    std::string name;
+    int line;
+
+    ThisGetExpr(size_t d, std::string n, int line);
+};
+
+// `object.name(arguments)`, calling a method without binding it first
+struct InvokeExpr {
+    std::unique_ptr<Expr> object;
+    Token name;
+    Token paren;
+    std::vector<Expr> arguments;
+    mutable Specialization specialization = Specialization::Uninitialized;
+    mutable Ref<class Class> cachedClass;
+    mutable Ref<class Function> cachedMethod;
+
+    InvokeExpr(std::unique_ptr<Expr> o, Token n, Token p, std::vector<Expr> a);
+};
+
 } // cpplox
 
 template <>
@@ -272,4 +342,56 @@ struct std::formatter<cpplox::VarExpr> {
     auto format(const cpplox::VarExpr& e, FormatContext& ctx) const {
         return std::format_to(ctx.out(), "{} {}", e.name.lexeme(), e.name.line());
     }
+};
+
+template <>
+struct std::formatter<cpplox::LocalCompareExpr> {
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx) {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const cpplox::LocalCompareExpr& e, FormatContext& ctx) const {
+        return std::format_to(ctx.out(), "({} {} {})", e.op, e.left, e.right);
+    }
+};
+
+template <>
+struct std::formatter<cpplox::LocalIncrementExpr> {
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx) {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const cpplox::LocalIncrementExpr& e, FormatContext& ctx) const {
+        return std::format_to(ctx.out(), "({} = ({} {} {}))", e.name, e.op, e.name, e.step);
+    }
+};
+
+template <>
+struct std::formatter<cpplox::ThisGetExpr> {
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx) {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const cpplox::ThisGetExpr& e, FormatContext& ctx) const {
+        return std::format_to(ctx.out(), "this.{}", e.name);
+    }
+};
+
+template <>
+struct std::formatter<cpplox::InvokeExpr> {
+    template<typename ParseContext>
+    constexpr auto parse(ParseContext& ctx) {
+        return ctx.begin();
+    }
+
+    template<typename FormatContext>
+    auto format(const cpplox::InvokeExpr& e, FormatContext& ctx) const {
+        return std::format_to(ctx.out(), "{}.{}({})", *e.object, e.name.lexeme(), e.arguments);
+    }
 };
\ No newline at end of file
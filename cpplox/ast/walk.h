@@ -0,0 +1,152 @@
+#pragma once
+
+#include <variant>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+
+namespace cpplox {
+
+// Visitor behind walk()
+template <typename Visit>
+class PreOrder {
+public:
+    explicit PreOrder(Visit& visit) : visit_(visit) {}
+
+    void operator()(const AssignExpr& expr) {
+        walk(*expr.object);
+    }
+
+    void operator()(const BinaryExpr& expr) {
+        walk(*expr.left);
+        walk(*expr.right);
+    }
+
+    void operator()(const CallExpr& expr) {
+        walk(*expr.callee);
+        walk(expr.arguments);
+    }
+
+    void operator()(const GetExpr& expr) {
+        walk(*expr.object);
+    }
+
+    void operator()(const GroupingExpr& expr) {
+        walk(*expr.expr);
+    }
+
+    void operator()(const LogicalExpr& expr) {
+        walk(*expr.left);
+        walk(*expr.right);
+    }
+
+    void operator()(const SetExpr& expr) {
+        walk(*expr.object);
+        walk(*expr.value);
+    }
+
+    void operator()(const UnaryExpr& expr) {
+        walk(*expr.right);
+    }
+
+    void operator()(const InvokeExpr& expr) {
+        walk(*expr.object);
+        walk(expr.arguments);
+    }
+
+    // Leaves
+    void operator()(const LiteralExpr&) {}
+    void operator()(const SuperExpr&) {}
+    void operator()(const ThisExpr&) {}
+    void operator()(const VarExpr&) {}
+    void operator()(const LocalCompareExpr&) {}
+    void operator()(const LocalIncrementExpr&) {}
+    void operator()(const ThisGetExpr&) {}
+
+    void operator()(const BlockStatement& stmt) {
+        walk(stmt.statements);
+    }
+
+    void operator()(const ClassStatement& stmt) {
+        if (stmt.superclass.has_value()) {
+            walk(*stmt.superclass);
+        }
+        for (const FunctionStatement& method : stmt.methods) {
+            walk(method);
+        }
+    }
+
+    void operator()(const ExprStatement& stmt) {
+        walk(stmt.expr);
+    }
+
+    void operator()(const FunctionStatement& stmt) {
+        walk(*stmt.body);
+    }
+
+    void operator()(const IfStatement& stmt) {
+        walk(stmt.condition);
+        walk(*stmt.thenBranch);
+        if (stmt.elseBranch) {
+            walk(*stmt.elseBranch);
+        }
+    }
+
+    void operator()(const PrintStatement& stmt) {
+        walk(stmt.expr);
+    }
+
+    void operator()(const ReturnStatement& stmt) {
+        if (stmt.value.has_value()) {
+            walk(*stmt.value);
+        }
+    }
+
+    void operator()(const VarStatement& stmt) {
+        if (stmt.initializer.has_value()) {
+            walk(*stmt.initializer);
+        }
+    }
+
+    void operator()(const WhileStatement& stmt) {
+        walk(stmt.condition);
+        walk(*stmt.body);
+    }
+
+    void walk(const Expr& expr) {
+        std::visit([this](const auto& node) { walk(node); }, expr);
+    }
+
+    void walk(const Statement& stmt) {
+        std::visit([this](const auto& node) { walk(node); }, stmt);
+    }
+
+    template <typename T>
+    void walk(const std::vector<T>& nodes) {
+        for (const T& node : nodes) {
+            walk(node);
+        }
+    }
+
+    template <typename T>
+    void walk(const T& node) {
+        visit_(site_++, node);
+        operator()(node);
+    }
+
+private:
+    Visit& visit_;
+    size_t site_ = 0;
+};
+
+// Hands every node of a program, numbered in pre-order, to `visit`, as
+// visit(size_t site, const Node& node). Methods and the bodies of functions
+// and loops are nodes too. Passes that only look at some kinds of nodes
+// don't need a visitor of their own.
+template <typename Visit>
+void walk(const std::vector<Statement>& stmts, Visit visit) {
+    PreOrder<Visit>(visit).walk(stmts);
+}
+
+} // cpplox
\ No newline at end of file
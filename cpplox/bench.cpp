@@ -0,0 +1,50 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <print>
+#include <sstream>
+#include <vector>
+
+#include <driver/driver.h>
+
+namespace {
+
+constexpr int runs = 5;
+
+// Median wall time of running the script, in milliseconds
+double measure(const std::filesystem::path& script, cpplox::Engine engine) {
+    std::vector<double> times;
+    for (int i = 0; i < runs; i++) {
+        std::stringstream out;
+        cpplox::InterpreterDriver driver(out, engine);
+        auto start = std::chrono::steady_clock::now();
+        driver.runScript(script);
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::ranges::sort(times);
+    return times[runs / 2];
+}
+
+}
+
+// Compares the engines on the given scripts, or on the bench/ corpus.
+int main(int argc, char* argv[]) {
+    std::vector<std::filesystem::path> scripts(argv + 1, argv + argc);
+    if (scripts.empty()) {
+        for (const auto& entry : std::filesystem::directory_iterator(BENCH_DIR)) {
+            if (entry.path().extension() == ".lox") {
+                scripts.push_back(entry.path());
+            }
+        }
+        std::ranges::sort(scripts);
+    }
+
+    std::print("{:<24}{:>12}{:>14}{:>12}{:>10}\n", "script", "tree (ms)", "closure (ms)", "tiered (ms)", "speedup");
+    for (const auto& script : scripts) {
+        double tree = measure(script, cpplox::Engine::TreeWalk);
+        double closure = measure(script, cpplox::Engine::Closure);
+        double tiered = measure(script, cpplox::Engine::Tiered);
+        std::print("{:<24}{:>12.1f}{:>14.1f}{:>12.1f}{:>9.2f}x\n", script.filename().string(), tree, closure, tiered, tree / std::min(closure, tiered));
+    }
+    return 0;
+}
\ No newline at end of file
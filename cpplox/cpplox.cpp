@@ -1,12 +1,78 @@
+#include <optional>
 #include <print>
+#include <string>
+#include <string_view>
 
 #include <driver/driver.h>
 
 int main(int argc, char* argv[]) {
-    cpplox::InterpreterDriver driver;
+    // --stats reports the superinstruction sites fused in the program, the
+    // operators type inference proved numeric, the functions found pure and
+    // how many environments were recycled and how many objects the end of the
+    // run freed in bulk. --memoize caches the results of calls to pure functions.
+    // --defer-release destroys what the program lets go of a slice at a time
+    // between statements. --max-depth runs the program on a stack of its own
+    // where calls nested deeper than given fail with "Stack overflow.".
+    // Programs start in the tree-walker and tier up to the closure compiler;
+    // --tree-walk keeps them there, --compile compiles them up front.
+    // --profile-out saves the type feedback of the run, --profile-in starts
+    // the next run of the same script with it.
+    bool stats = false;
+    bool memoize = false;
+    bool deferRelease = false;
+    std::optional<size_t> maxDepth;
+    std::string_view profileIn;
+    std::string_view profileOut;
+    cpplox::Engine engine = cpplox::Engine::Tiered;
+    while (argc > 1 && std::string_view(argv[1]).starts_with("--")) {
+        if (std::string_view(argv[1]) == "--stats") {
+            stats = true;
+        } else if (std::string_view(argv[1]) == "--compile") {
+            engine = cpplox::Engine::Closure;
+        } else if (std::string_view(argv[1]) == "--tree-walk") {
+            engine = cpplox::Engine::TreeWalk;
+        } else if (std::string_view(argv[1]) == "--memoize") {
+            memoize = true;
+        } else if (std::string_view(argv[1]) == "--defer-release") {
+            deferRelease = true;
+        } else if (std::string_view(argv[1]) == "--max-depth" && argc > 2) {
+            maxDepth = std::stoul(argv[2]);
+            argc--;
+            argv++;
+        } else if (std::string_view(argv[1]) == "--profile-in" && argc > 2) {
+            profileIn = argv[2];
+            argc--;
+            argv++;
+        } else if (std::string_view(argv[1]) == "--profile-out" && argc > 2) {
+            profileOut = argv[2];
+            argc--;
+            argv++;
+        } else {
+            break;
+        }
+        argc--;
+        argv++;
+    }
+
+    cpplox::InterpreterDriver driver(std::cout, engine);
+    if (memoize) {
+        driver.memoize();
+    }
+    if (deferRelease) {
+        driver.deferReleases();
+    }
+    if (maxDepth) {
+        driver.limitDepth(*maxDepth);
+    }
+    if (!profileIn.empty()) {
+        driver.loadProfile(profileIn);
+    }
+    if (!profileOut.empty()) {
+        driver.saveProfile(profileOut);
+    }
 
     if (argc > 2) {
-        std::print("Usage: cpplox [script]\n");
+        std::print("Usage: cpplox [--stats] [--compile | --tree-walk] [--memoize] [--defer-release] [--max-depth n] [--profile-in file] [--profile-out file] [script]\n");
     } else if (argc == 2) {
         std::print("Running {}\n", argv[1]);
         driver.runScript(argv[1]);
@@ -14,5 +80,22 @@ int main(int argc, char* argv[]) {
         std::print("Running REPL mode.\n");
         driver.runPrompt();
     }
+
+    if (stats) {
+        const auto& fused = driver.stats();
+        std::print(stderr, "fused: {} local compares, {} local increments, {} this gets, {} invokes\n",
+            fused.localCompares, fused.localIncrements, fused.thisGets, fused.invokes);
+        const auto& scalars = driver.scalarStats();
+        std::print(stderr, "scalar replaced: {} of {} instances\n", scalars.replaced, scalars.allocations);
+        const auto& types = driver.typeStats();
+        std::print(stderr, "proven: {} of {} binary operators, {} of {} negations\n",
+            types.provenBinaries, types.binaries, types.provenNegations, types.negations);
+        const auto& purity = driver.purityStats();
+        std::print(stderr, "pure: {} of {} functions\n", purity.pure, purity.functions);
+        const auto& environments = cpplox::EnvironmentPool::instance().stats();
+        std::print(stderr, "environments: {} recycled, {} allocated\n", environments.hits, environments.misses);
+        const auto& region = driver.regionStats();
+        std::print(stderr, "region: {} objects freed at exit, {} exported\n", region.freed, region.exported);
+    }
     return 0;
 }
\ No newline at end of file
@@ -6,14 +6,26 @@
 #include <ast/expr.h>
 #include <diagnostic/diagnostic.h>
 #include <driver/driver.h>
+#include <env/compiler.h>
 #include <env/interpreter.h>
+#include <env/optimizer.h>
 #include <env/resolver.h>
+#include <profile/profile.h>
 #include <parser/parser.h>
 #include <scanner/scanner.h>
+#include <util/scope_guard.h>
+#include <util/stack.h>
 
 namespace cpplox {
 
-InterpreterDriver::InterpreterDriver(std::ostream& out) : out_(out) {}
+InterpreterDriver::InterpreterDriver(std::ostream& out, Engine engine) : out_(out), engine_(engine) {}
+
+InterpreterDriver::Run::Run(InterpreterDriver& driver, std::vector<Statement> stmts)
+    : released{ driver, {} }, stmts(std::move(stmts)), interpreter(driver.diagnostic_, driver.out_) {}
+
+InterpreterDriver::Run::~Run() {
+    released.region.hold();
+}
 
 void InterpreterDriver::run(const std::string& program) {
     Scanner scanner(program, diagnostic_);
@@ -23,19 +35,41 @@ void InterpreterDriver::run(const std::string& program) {
     }
 
     Parser parser(tokens, diagnostic_);
-    auto stmts = parser.parse();
-    if (diagnostic_.hadError() || !stmts.has_value()) {
+    auto parsed = parser.parse();
+    if (diagnostic_.hadError() || !parsed.has_value()) {
         return;
     }
 
-    Interpreter interpreter(diagnostic_, out_);
+    Run run(*this, std::move(*parsed));
+    Interpreter& interpreter = run.interpreter;
+    std::vector<Statement>& stmts = run.stmts;
+    setUp(interpreter);
+    replaceScalars(stmts);
     Resolver resolver(interpreter);
-    resolver.resolve(*stmts);
+    resolver.resolve(stmts);
     if (diagnostic_.hadError()) {
         return;
     }
+    optimize(interpreter, stmts);
+    analyze(interpreter, stmts);
+
+    if (!profileIn_.empty()) {
+        std::ifstream file(profileIn_);
+        std::string error = "could not open it";
+        auto profile = file.is_open() ? Profile::load(file, program, error) : std::nullopt;
+        if (profile.has_value()) {
+            profile->apply(stmts, interpreter);
+        } else {
+            std::print(stderr, "Ignoring profile {}: {}.\n", profileIn_.string(), error);
+        }
+    }
 
-    interpreter.interpret(*stmts);
+    execute(interpreter, stmts);
+    // Also when the program failed, as far as it got is worth keeping
+    if (!profileOut_.empty()) {
+        std::ofstream file(profileOut_);
+        Profile::record(stmts, interpreter, program).save(file);
+    }
     if (diagnostic_.hadError()) {
         return;
     }
@@ -57,8 +91,8 @@ void InterpreterDriver::runExpr(const std::string& program) {
 
     std::print(out_, "expression: {}\n", *expr);
 
-    Interpreter interpreter(diagnostic_, out_);
-    auto object = interpreter.interpretExpr(*expr);
+    Run run(*this);
+    auto object = run.interpreter.interpretExpr(*expr);
     if (diagnostic_.hadError() || !expr.has_value()) {
         return;
     }
@@ -78,7 +112,9 @@ void InterpreterDriver::runScript(const std::filesystem::path& path) {
 }
 
 void InterpreterDriver::runPrompt() {
-    Interpreter interpreter(diagnostic_, out_);
+    Run run(*this);
+    Interpreter& interpreter = run.interpreter;
+    setUp(interpreter);
     Resolver resolver(interpreter);
     resolver.beginScope();
     std::string line;
@@ -98,12 +134,18 @@ void InterpreterDriver::runPrompt() {
             return;
         }
 
+        replaceScalars(*stmts);
         resolver.resolve(*stmts, false);
         if (diagnostic_.hadError()) {
             return;
         }
+        optimize(interpreter, *stmts);
+        analyze(interpreter, *stmts);
 
-        interpreter.interpret(*stmts);
+        execute(interpreter, *stmts);
+        // The line is freed next, and the resolver is about to change the
+        // tables the compiler reads.
+        interpreter.cancelCompiles();
         if (diagnostic_.hadError()) {
             return;
         }
@@ -113,5 +155,89 @@ void InterpreterDriver::runPrompt() {
     resolver.endScope();
 }
 
+// The image was scanned, parsed, resolved and optimized when it was built.
+void InterpreterDriver::runImage(const ProgramImage& image) {
+    Run run(*this);
+    setUp(run.interpreter);
+    run.stmts = ImageReader(image, run.interpreter).read();
+    analyze(run.interpreter, run.stmts);
+
+    execute(run.interpreter, run.stmts);
+}
+
+void InterpreterDriver::replaceScalars(std::vector<Statement>& stmts) {
+    ScalarReplacement replacement;
+    replacement.replace(stmts);
+    scalarStats_ += replacement.stats();
+}
+
+void InterpreterDriver::optimize(Interpreter& interpreter, std::vector<Statement>& stmts) {
+    Optimizer optimizer(interpreter);
+    optimizer.optimize(stmts);
+    stats_ += optimizer.stats();
+}
+
+void InterpreterDriver::analyze(Interpreter& interpreter, const std::vector<Statement>& stmts) {
+    TypeInference inference(interpreter);
+    inference.infer(stmts);
+    typeStats_ += inference.stats();
+
+    PurityAnalysis purity(interpreter);
+    purity.analyze(stmts);
+    purityStats_ += purity.stats();
+}
+
+void InterpreterDriver::execute(Interpreter& interpreter, const std::vector<Statement>& stmts) {
+    auto run = [&] {
+        if (engine_ == Engine::Closure) {
+            Compiler compiler(interpreter);
+            interpreter.interpret(compiler.compile(stmts));
+            return;
+        }
+        interpreter.interpret(stmts);
+    };
+    if (!maxDepth_) {
+        run();
+        return;
+    }
+    // Deep enough for the deepest calls allowed, so that they fail first.
+    // Calls taking more native stack than that fail once it runs low.
+    Stack stack(*maxDepth_ * stackPerCall + Interpreter::stackMargin);
+    interpreter.limitStack(stack.bottom());
+    ScopeGuard unlimit{ [&] {
+        interpreter.limitStack(nullptr);
+    } };
+    stack.run(run);
+}
+
+void InterpreterDriver::release(Region& region) {
+    region.release([] {
+        Interpreter::clearGlobals();
+    });
+    regionStats_ += region.stats();
+}
+
+void InterpreterDriver::setUp(Interpreter& interpreter) {
+    if (memoCapacity_) {
+        interpreter.enableMemoization(*memoCapacity_);
+    }
+    if (releaseSlice_) {
+        interpreter.deferReleases(*releaseSlice_);
+    }
+    if (maxDepth_) {
+        interpreter.limitDepth(*maxDepth_);
+    }
+    if (engine_ != Engine::Tiered) {
+        return;
+    }
+    interpreter.enableTiering(
+        [&interpreter](const FunctionStatement& function) {
+            return Compiler(interpreter).compileBody(function);
+        },
+        [&interpreter](const WhileStatement& loop) {
+            return Compiler(interpreter)(loop);
+        });
+}
+
 } // cpplox
 
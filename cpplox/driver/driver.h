@@ -5,19 +5,137 @@
 #include <iostream>
 
 #include <diagnostic/diagnostic.h>
+#include <env/inference.h>
+#include <env/interpreter.h>
+#include <env/optimizer.h>
+#include <env/purity.h>
+#include <env/region.h>
+#include <env/scalar.h>
+#include <image/image.h>
 
 namespace cpplox {
 
+// How resolved programs are executed
+enum class Engine {
+    TreeWalk, // Interpreter walks the AST
+    Closure,  // Compiler turns the AST into callables first
+    Tiered,   // Interpreter walks the AST, hot code is compiled in the background
+};
+
 class InterpreterDriver {
 public:
-    explicit InterpreterDriver(std::ostream& out = std::cout);
+    // Native stack set aside for each nested call, with room to spare for
+    // the expressions and blocks within it. A call nesting them deeper than
+    // that fails once the stack runs low, see Interpreter::limitStack().
+    static constexpr size_t stackPerCall = 16 * 1024;
+
+    explicit InterpreterDriver(std::ostream& out = std::cout, Engine engine = Engine::TreeWalk);
     void runExpr(const std::string& program);
     void run(const std::string& program);
     void runScript(const std::filesystem::path& path);
     void runPrompt();
+    // Runs a program embedded by cpplox_embed
+    void runImage(const ProgramImage& image);
+
+    // Programs run() starts with the type feedback saved in `path`, if it
+    // was recorded for the same source
+    void loadProfile(std::filesystem::path path) {
+        profileIn_ = std::move(path);
+    }
+
+    // Programs run() save their type feedback to `path` once they finish
+    void saveProfile(std::filesystem::path path) {
+        profileOut_ = std::move(path);
+    }
+
+    // Superinstruction sites fused in everything run so far
+    const Optimizer::Stats& stats() const {
+        return stats_;
+    }
+
+    // Instances replaced by their fields in everything run so far
+    const ScalarReplacement::Stats& scalarStats() const {
+        return scalarStats_;
+    }
+
+    // Operator sites type inference analyzed in everything run so far
+    const TypeInference::Stats& typeStats() const {
+        return typeStats_;
+    }
+
+    // Functions found pure in everything run so far
+    const PurityAnalysis::Stats& purityStats() const {
+        return purityStats_;
+    }
+
+    // Objects freed and kept alive when the runs so far ended
+    const Region::Stats& regionStats() const {
+        return regionStats_;
+    }
+
+    // Programs run from now on cache the results of their pure functions
+    void memoize(size_t capacity = Memo::defaultCapacity) {
+        memoCapacity_ = capacity;
+    }
+
+    // Programs run from now on run on a call stack of their own, allocated on
+    // the heap with room for calls nested `depth` deep, and fail with a
+    // "Stack overflow." error past that instead of crashing
+    void limitDepth(size_t depth) {
+        maxDepth_ = depth;
+    }
+
+    // Programs run from now on destroy what they let go of a slice at a time
+    // between statements, see Interpreter::deferReleases()
+    void deferReleases(size_t slice = ReleaseQueue::defaultSlice) {
+        releaseSlice_ = slice;
+    }
 private:
+    // One run of a program. The interpreter's objects belong to a region of
+    // their own, which is held while the interpreter and the program's
+    // statements go, and released after, along with the globals.
+    struct Run {
+        // The region, released once everything after it went
+        struct Released {
+            InterpreterDriver& driver;
+            Region region;
+
+            ~Released() {
+                driver.release(region);
+            }
+        };
+
+        Run(InterpreterDriver& driver, std::vector<Statement> stmts = {});
+        ~Run();
+
+        Released released;
+        std::vector<Statement> stmts;
+        Interpreter interpreter;
+    };
+
+    // Before resolution, see ScalarReplacement
+    void replaceScalars(std::vector<Statement>& stmts);
+    void optimize(Interpreter& interpreter, std::vector<Statement>& stmts);
+    // Type inference and purity analysis, which only mark nodes
+    void analyze(Interpreter& interpreter, const std::vector<Statement>& stmts);
+    void setUp(Interpreter& interpreter);
+    void execute(Interpreter& interpreter, const std::vector<Statement>& stmts);
+    // Ends a run, along with the globals it defined
+    void release(Region& region);
+
     Diagnostic diagnostic_;
+    Optimizer::Stats stats_;
+    ScalarReplacement::Stats scalarStats_;
+    TypeInference::Stats typeStats_;
+    PurityAnalysis::Stats purityStats_;
+    Region::Stats regionStats_;
+    std::optional<size_t> memoCapacity_;
+    std::optional<size_t> releaseSlice_;
+    std::optional<size_t> maxDepth_;
     std::ostream& out_;
+    Engine engine_;
+    std::filesystem::path profileIn_;
+    std::filesystem::path profileOut_;
 };
 
 } // cpplox
\ No newline at end of file
@@ -7,75 +7,119 @@
 #include <driver/driver.h>
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
 using namespace cpplox;
 
 TEST_CASE("Class") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "class.lox"));
     REQUIRE(ss.str() == "<class MyClass>\n\"0\"\n\"1\"\n\"hello\"\n<instance of <class MyClass>>\n");
 }
 
 TEST_CASE("ComplexReturn") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "complex_return.lox"));
     REQUIRE(ss.str() == "1\n2\n3\n");
 }
 
 TEST_CASE("Control") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "control.lox"));
     REQUIRE(ss.str() == "0\n1\n1\n2\n3\n5\n8\n13\n21\n34\n55\n89\n144\n233\n377\n610\n987\n1597\n2584\n4181\n6765\n");
 }
 
 TEST_CASE("Fib") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "fib.lox"));
     REQUIRE(ss.str() == "0\n1\n1\n2\n3\n5\n8\n13\n21\n34\n55\n89\n144\n233\n377\n610\n987\n1597\n2584\n4181\n");
 }
 
 TEST_CASE("Fn") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "fn.lox"));
     REQUIRE(ss.str() == "<fn IDENTIFIER add>\n3\n<fn IDENTIFIER sayHi>\n\"Hi, Dear Reader!\"\n");
 }
 
 TEST_CASE("LocalFunction") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "local_function.lox"));
     REQUIRE(ss.str() == "1\n2\n");
 }
 
 TEST_CASE("Scope") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "scope.lox"));
     REQUIRE(ss.str() == "\"inner a\"\n\"outer b\"\n\"global c\"\n\"outer a\"\n\"outer b\"\n\"global c\"\n\"global a\"\n\"global b\"\n\"global c\"\n");
 }
 
 TEST_CASE("StaticScope") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "static_scope.lox"));
     REQUIRE(ss.str() == "\"global\"\n\"global\"\n");
 }
 
 TEST_CASE("ClassTest") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "class.lox"));
     REQUIRE(ss.str() == "<class MyClass>\n\"0\"\n\"1\"\n\"hello\"\n<instance of <class MyClass>>\n");
 }
 
 TEST_CASE("Inhertiance") {
     std::stringstream ss;
-    InterpreterDriver driver(ss);
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
     driver.runScript(std::format("{}/{}", SAMPLE_DIR, "inheritance.lox"));
     REQUIRE(ss.str() == "\"Doughnut\"\n\"BostonCream\"\n");
+}
+
+TEST_CASE("LoopScope") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runScript(std::format("{}/{}", SAMPLE_DIR, "loop_scope.lox"));
+    REQUIRE(ss.str() == "6\n0\n1\n0\n1\n0\n");
+}
+
+
+TEST_CASE("Upvalue") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runScript(std::format("{}/{}", SAMPLE_DIR, "upvalue.lox"));
+    REQUIRE(ss.str() == "2\n10\n\"outer x\"\n\"made\"\n7\n\"base\"\n");
+}
+
+
+TEST_CASE("Frames") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runScript(std::format("{}/{}", SAMPLE_DIR, "frames.lox"));
+    REQUIRE(ss.str() == "5052\n58\n");
+}
+
+
+TEST_CASE("Specialize") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runScript(std::format("{}/{}", SAMPLE_DIR, "specialize.lox"));
+    REQUIRE(ss.str() == "1\n2\n3\n\"specialized\"\ntrue\n0\n9\n7\n");
+}
+
+
+TEST_CASE("Fusion") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runScript(std::format("{}/{}", SAMPLE_DIR, "fusion.lox"));
+    REQUIRE(ss.str() == "10\n-1\n16\n6\n8\n17\n");
+    REQUIRE(driver.stats().localCompares == 1);
+    REQUIRE(driver.stats().localIncrements == 2);
+    REQUIRE(driver.stats().thisGets == 1);
+    REQUIRE(driver.stats().invokes == 6);
 }
\ No newline at end of file
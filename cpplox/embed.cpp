@@ -0,0 +1,63 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+
+#include <diagnostic/diagnostic.h>
+#include <env/interpreter.h>
+#include <env/optimizer.h>
+#include <env/resolver.h>
+#include <env/scalar.h>
+#include <image/image.h>
+#include <parser/parser.h>
+#include <scanner/scanner.h>
+
+int main(int argc, char* argv[]) {
+    // Compiles a script into a header defining its ProgramImage as
+    // embedded::<name>. Errors in the script fail the build that runs this.
+    if (argc != 4) {
+        std::print("Usage: cpplox_embed script name header\n");
+        return 64;
+    }
+    std::filesystem::path script = argv[1];
+    std::string name = argv[2];
+    std::filesystem::path header = argv[3];
+
+    std::ifstream file(script);
+    if (!file.is_open()) {
+        std::print(stderr, "Could not open {}.\n", script.string());
+        return 66;
+    }
+    std::string program{ std::istreambuf_iterator<char>(file), {} };
+
+    cpplox::Diagnostic diagnostic;
+    cpplox::Scanner scanner(program, diagnostic);
+    auto tokens = scanner.scanTokens();
+    if (diagnostic.hadError()) {
+        return 65;
+    }
+    cpplox::Parser parser(tokens, diagnostic);
+    auto stmts = parser.parse();
+    if (diagnostic.hadError() || !stmts.has_value()) {
+        return 65;
+    }
+    cpplox::Interpreter interpreter(diagnostic);
+    cpplox::ScalarReplacement().replace(*stmts);
+    cpplox::Resolver resolver(interpreter);
+    resolver.resolve(*stmts);
+    if (diagnostic.hadError()) {
+        return 65;
+    }
+    cpplox::Optimizer(interpreter).optimize(*stmts);
+
+    cpplox::ImageWriter writer(interpreter);
+    writer.write(*stmts);
+    std::ofstream out(header);
+    out << writer.header(name, script.filename().string());
+    if (!out) {
+        std::print(stderr, "Could not write {}.\n", header.string());
+        return 74;
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,549 @@
+#include <env/compiler.h>
+
+#include <functional>
+#include <print>
+#include <variant>
+
+#include <env/number.h>
+#include <env/object.h>
+#include <util/scope_guard.h>
+
+namespace cpplox {
+
+Compiler::ExprCode Compiler::operator()(const AssignExpr& expr) {
+    auto value = compile(*expr.object);
+    if (auto depth = interpreter_.resolvedDepth(&expr)) {
+        return [value = std::move(value), name = expr.name, depth = *depth](Interpreter& i) -> Object {
+            Object object = value(i);
+            i.env_->assignAt(depth, name, object);
+            return object;
+        };
+    }
+    return [value = std::move(value), name = expr.name](Interpreter& i) -> Object {
+        Object object = value(i);
+        Interpreter::globals_.assign(name, object);
+        return object;
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const BinaryExpr& expr) {
+    // Doubles take the operator bound here, integers the interpreter's
+    // integer handler and anything else its generic one. Proven operands are
+    // numbers.
+    auto binary = [left = compileRead(*expr.left, Interpreter::isReadOnly(*expr.right)), right = compileRead(*expr.right), op = expr.op.type(), line = expr.op.line(), proven = interpreter_.isProven(&expr)]<typename Op>(Op) -> ExprCode {
+        if (proven) {
+            return [left, right, op](Interpreter& i) -> Object {
+                Object leftScratch, rightScratch;
+                const Object& l = left(i, leftScratch);
+                const Object& r = right(i, rightScratch);
+                if (auto* a = std::get_if<int64_t>(&l), *b = std::get_if<int64_t>(&r); a && b) {
+                    return i.binaryIntegers(op, *a, *b);
+                }
+                return Op{}(toDouble(l), toDouble(r));
+            };
+        }
+        return [left, right, op, line](Interpreter& i) -> Object {
+            Object leftScratch, rightScratch;
+            const Object& l = left(i, leftScratch);
+            const Object& r = right(i, rightScratch);
+            if (auto* a = std::get_if<double>(&l), *b = std::get_if<double>(&r); a && b) {
+                return Op{}(*a, *b);
+            }
+            if (auto* a = std::get_if<int64_t>(&l), *b = std::get_if<int64_t>(&r); a && b) {
+                return i.binaryIntegers(op, *a, *b);
+            }
+            return i.binaryGeneric(op, line, l, r);
+        };
+    };
+
+    switch (expr.op.type()) {
+        case TokenType::BANG_EQUAL:
+            return binary(std::not_equal_to<double>{});
+        case TokenType::EQUAL_EQUAL:
+            return binary(std::equal_to<double>{});
+        case TokenType::GREATER:
+            return binary(std::greater<double>{});
+        case TokenType::GREATER_EQUAL:
+            return binary(std::greater_equal<double>{});
+        case TokenType::LESS:
+            return binary(std::less<double>{});
+        case TokenType::LESS_EQUAL:
+            return binary(std::less_equal<double>{});
+        case TokenType::MINUS:
+            return binary(std::minus<double>{});
+        case TokenType::SLASH:
+            return binary(std::divides<double>{});
+        case TokenType::STAR:
+            return binary(std::multiplies<double>{});
+        case TokenType::PLUS:
+            return binary(std::plus<double>{});
+        default:
+            // Unreachable.
+            break;
+    }
+    std::unreachable();
+}
+
+Compiler::ExprCode Compiler::operator()(const CallExpr& expr) {
+    return [callee = compile(*expr.callee), arguments = compileArguments(expr.arguments), &paren = expr.paren](Interpreter& i) -> Object {
+        Object object = callee(i);
+        return i.callValue(object, evaluate(i, arguments), paren);
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const GetExpr& expr) {
+    return [object = compileRead(*expr.object), &name = expr.name](Interpreter& i) -> Object {
+        Object scratch;
+        const Object& value = object(i, scratch);
+        if (auto* instance = std::get_if<InstancePtr>(&value)) {
+            if (auto ret = (*instance)->get(name)) {
+                return *ret;
+            }
+            i.error(name, "Undefined property '" + name.lexeme() + "'.");
+            throw RuntimeError();
+        }
+        i.error(name, "Only instances have properties.");
+        throw RuntimeError();
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const GroupingExpr& expr) {
+    return compile(*expr.expr);
+}
+
+Compiler::ExprCode Compiler::operator()(const LiteralExpr& expr) {
+    Object value = nullptr;
+    if (auto* number = expr.object ? std::get_if<double>(&*expr.object) : nullptr) {
+        value = cpplox::number(*number);
+    } else if (expr.object.has_value()) {
+        value = std::visit([](const auto& l) { return Object{ l }; }, *expr.object);
+    }
+    return [value = std::move(value)](Interpreter&) -> Object {
+        return value;
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const LogicalExpr& expr) {
+    if (expr.op.type() == TokenType::OR) {
+        return [left = compileRead(*expr.left), right = compile(*expr.right)](Interpreter& i) -> Object {
+            Object scratch;
+            const Object& object = left(i, scratch);
+            if (Interpreter::isTruthy(object)) { return object; }
+            return right(i);
+        };
+    }
+    return [left = compileRead(*expr.left), right = compile(*expr.right)](Interpreter& i) -> Object {
+        Object scratch;
+        const Object& object = left(i, scratch);
+        if (!Interpreter::isTruthy(object)) { return object; }
+        return right(i);
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const SetExpr& expr) {
+    return [object = compile(*expr.object), value = compile(*expr.value), &name = expr.name](Interpreter& i) -> Object {
+        Object target = object(i);
+        if (auto* instance = std::get_if<InstancePtr>(&target)) {
+            Object v = value(i);
+            (*instance)->set(name, v);
+            return v;
+        }
+        i.error(name, "Only instances have fields.");
+        throw RuntimeError();
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const SuperExpr& expr) {
+    size_t superDepth = interpreter_.resolvedDepth(&expr).value_or(0);
+    size_t thisDepth = interpreter_.resolvedDepth(&expr.method).value_or(0);
+    return [superDepth, thisDepth, &method = expr.method](Interpreter& i) -> Object {
+        auto superclass = i.env_->getAt(superDepth, "super");
+        auto instance = i.env_->getAt(thisDepth, "this");
+        auto function = std::get<ClassPtr>(superclass)->findMethod(method.lexeme());
+        if (!function) {
+            i.error(method, "Undefined property '" + method.lexeme() + "'.");
+            throw RuntimeError();
+        }
+        return function->bind(std::get<InstancePtr>(instance));
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const ThisExpr& expr) {
+    return lookUpVariable(expr.keyword, &expr);
+}
+
+Compiler::ExprCode Compiler::operator()(const UnaryExpr& expr) {
+    if (expr.op.type() == TokenType::BANG) {
+        return [right = compileRead(*expr.right)](Interpreter& i) -> Object {
+            Object scratch;
+            return !Interpreter::isTruthy(right(i, scratch));
+        };
+    }
+    if (interpreter_.isProven(&expr)) {
+        return [right = compileRead(*expr.right)](Interpreter& i) -> Object {
+            Object scratch;
+            const Object& object = right(i, scratch);
+            return negate(object);
+        };
+    }
+    return [right = compileRead(*expr.right), line = expr.op.line()](Interpreter& i) -> Object {
+        Object scratch;
+        const Object& object = right(i, scratch);
+        if (isNumber(object)) {
+            return negate(object);
+        }
+        i.checkNumberOperands(line, object);
+        std::unreachable();
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const VarExpr& expr) {
+    return lookUpVariable(expr.name, &expr);
+}
+
+Compiler::ExprCode Compiler::operator()(const LocalCompareExpr& expr) {
+    auto compare = [&expr]<typename Op>(Op) -> ExprCode {
+        return [&expr](Interpreter& i) -> Object {
+            const Object& left = i.env_->getAt(expr.leftDepth, expr.left);
+            const Object& right = i.env_->getAt(expr.rightDepth, expr.right);
+            if (auto* l = std::get_if<double>(&left), *r = std::get_if<double>(&right); l && r) {
+                return Op{}(*l, *r);
+            }
+            if (auto* l = std::get_if<int64_t>(&left), *r = std::get_if<int64_t>(&right); l && r) {
+                return Op{}(*l, *r);
+            }
+            return i.binaryGeneric(expr.op, expr.line, left, right);
+        };
+    };
+
+    switch (expr.op) {
+        case TokenType::GREATER:
+            return compare(std::greater<>{});
+        case TokenType::GREATER_EQUAL:
+            return compare(std::greater_equal<>{});
+        case TokenType::LESS:
+            return compare(std::less<>{});
+        case TokenType::LESS_EQUAL:
+            return compare(std::less_equal<>{});
+        default:
+            // Unreachable.
+            break;
+    }
+    std::unreachable();
+}
+
+// Superinstructions without operands to compile run the interpreter's own
+// handler directly.
+Compiler::ExprCode Compiler::operator()(const LocalIncrementExpr& expr) {
+    return [&expr](Interpreter& i) -> Object {
+        return i(expr);
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const ThisGetExpr& expr) {
+    return [&expr](Interpreter& i) -> Object {
+        return i(expr);
+    };
+}
+
+Compiler::ExprCode Compiler::operator()(const InvokeExpr& expr) {
+    return [object = compile(*expr.object), arguments = compileArguments(expr.arguments), &expr](Interpreter& i) -> Object {
+        Object target = object(i);
+        auto* instance = std::get_if<InstancePtr>(&target);
+        if (!instance) {
+            i.error(expr.name, "Only instances have properties.");
+            throw RuntimeError();
+        }
+
+        // Fields shadow methods.
+        if (auto it = (*instance)->fields_.find(expr.name.lexeme()); it != (*instance)->fields_.end()) {
+            Object callee = it->second;
+            return i.callValue(callee, evaluate(i, arguments), expr.paren);
+        }
+
+        FunctionPtr method = i.lookUpMethod(expr, *instance);
+        if (arguments.size() != method->arity()) {
+            evaluate(i, arguments);
+            i.error(expr.paren, std::format("Expected {} arguments but got {}.", method->arity(), arguments.size()));
+            throw RuntimeError();
+        }
+        return method->invoke(&i, *instance, evaluate(i, arguments));
+    };
+}
+
+StatementCode Compiler::operator()(const BlockStatement& stmt) {
+    return [block = compileBlock(stmt)](Interpreter& i) {
+        return block(i, nullptr);
+    };
+}
+
+StatementCode Compiler::operator()(const ClassStatement& stmt) {
+    ExprCode superclass;
+    if (stmt.superclass.has_value()) {
+        superclass = operator()(*stmt.superclass);
+    }
+
+    struct Method {
+        const FunctionStatement* declaration;
+        std::shared_ptr<const BlockCode> body;
+        FrameKind frame;
+    };
+    std::vector<Method> methods;
+    for (const FunctionStatement& method : stmt.methods) {
+        methods.push_back({ &method, std::make_shared<const BlockCode>(compileBlock(*method.body)), interpreter_.frameKind(method) });
+    }
+
+    return [&stmt, superclass = std::move(superclass), methods = std::move(methods)](Interpreter& i) -> std::optional<Object> {
+        ClassPtr super;
+        if (superclass) {
+            Object object = superclass(i);
+            if (!std::holds_alternative<ClassPtr>(object)) {
+                i.error(stmt.superclass->name, "Superclass must be a class.");
+                throw RuntimeError();
+            }
+            super = std::get<ClassPtr>(std::move(object));
+        }
+        i.env_->define(stmt.name.lexeme(), {});
+
+        EnvironmentPtr closure = i.makeClosure(&stmt);
+        if (super) {
+            closure = Environment::make(std::move(closure));
+            closure->define("super", super);
+        }
+
+        std::unordered_map<std::string, FunctionPtr> functions;
+        for (const auto& [declaration, body, frame] : methods) {
+            const auto& name = declaration->name.lexeme();
+            functions[name] = i.makeFunction(closure, *declaration, name == "init", frame, body.get());
+        }
+        i.env_->assign(stmt.name, makeRef<Class>(stmt.name.lexeme(), std::move(functions), std::move(super), i.constructor(stmt)));
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const ExprStatement& stmt) {
+    return [expr = compile(stmt.expr)](Interpreter& i) -> std::optional<Object> {
+        expr(i);
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const FunctionStatement& stmt) {
+    // Functions created at runtime share the body compiled here.
+    auto body = std::make_shared<const BlockCode>(compileBlock(*stmt.body));
+    return [&stmt, body, frame = interpreter_.frameKind(stmt)](Interpreter& i) -> std::optional<Object> {
+        // Declared first so that a recursive function can capture itself.
+        i.env_->define(stmt.name.lexeme(), {});
+        i.env_->define(stmt.name.lexeme(), i.makeFunction(i.makeClosure(&stmt), stmt, false, frame, body.get()));
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const IfStatement& stmt) {
+    StatementCode elseBranch;
+    if (stmt.elseBranch) {
+        elseBranch = compile(*stmt.elseBranch);
+    }
+    return [condition = compileRead(stmt.condition), thenBranch = compile(*stmt.thenBranch), elseBranch = std::move(elseBranch)](Interpreter& i) -> std::optional<Object> {
+        Object scratch;
+        if (Interpreter::isTruthy(condition(i, scratch))) {
+            return thenBranch(i);
+        } else if (elseBranch) {
+            return elseBranch(i);
+        }
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const PrintStatement& stmt) {
+    return [expr = compileRead(stmt.expr)](Interpreter& i) -> std::optional<Object> {
+        Object scratch;
+        std::print(i.out_, "{}\n", expr(i, scratch));
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const ReturnStatement& stmt) {
+    if (!stmt.value.has_value()) {
+        return [](Interpreter&) -> std::optional<Object> {
+            return Object{ nullptr };
+        };
+    }
+    return [value = compile(*stmt.value)](Interpreter& i) -> std::optional<Object> {
+        return value(i);
+    };
+}
+
+StatementCode Compiler::operator()(const VarStatement& stmt) {
+    ExprCode initializer;
+    if (stmt.initializer.has_value()) {
+        initializer = compile(*stmt.initializer);
+    }
+    return [initializer = std::move(initializer), &name = stmt.name.lexeme()](Interpreter& i) -> std::optional<Object> {
+        Object object;
+        if (initializer) {
+            object = initializer(i);
+        }
+        i.env_->define(name, std::move(object));
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::operator()(const WhileStatement& stmt) {
+    return [&stmt, condition = compileRead(stmt.condition), body = compileBlock(*stmt.body)](Interpreter& i) -> std::optional<Object> {
+        // Loops the tree-walker traced before they were promoted keep
+        // running their trace, as in Interpreter::operator()(const WhileStatement&).
+        Jit::Trace* trace = i.jit_.trace(stmt);
+        Object scratch;
+        while (Interpreter::isTruthy(condition(i, scratch))) {
+            if (trace) {
+                if (i.jit_.run(*trace, *i.env_, i.depthLeft()) == Jit::TraceExit::Finished) {
+                    return std::nullopt;
+                }
+                if (trace->blacklisted) {
+                    trace = nullptr;
+                }
+            }
+            if (auto ret = body(i, nullptr)) {
+                return ret;
+            }
+            i.safePoint();
+        }
+        return std::nullopt;
+    };
+}
+
+StatementCode Compiler::compile(const std::vector<Statement>& stmts) {
+    std::vector<StatementCode> code;
+    for (const auto& stmt : stmts) {
+        code.push_back(compile(stmt));
+    }
+    return [code = std::move(code)](Interpreter& i) -> std::optional<Object> {
+        for (const auto& stmt : code) {
+            if (auto ret = stmt(i)) {
+                return ret;
+            }
+            i.safePoint();
+        }
+        return std::nullopt;
+    };
+}
+
+BlockCode Compiler::compileBody(const FunctionStatement& stmt) {
+    return compileBlock(*stmt.body);
+}
+
+Compiler::ExprCode Compiler::compile(const Expr& expr) {
+    return std::visit(*this, expr);
+}
+
+Compiler::ReadCode Compiler::compileRead(const Expr& expr, bool borrow) {
+    if (auto* grouping = std::get_if<GroupingExpr>(&expr)) {
+        return compileRead(*grouping->expr, borrow);
+    }
+    const Token* name = nullptr;
+    const void* node = nullptr;
+    if (auto* var = std::get_if<VarExpr>(&expr)) {
+        name = &var->name;
+        node = var;
+    } else if (auto* self = std::get_if<ThisExpr>(&expr)) {
+        name = &self->keyword;
+        node = self;
+    }
+    if (!borrow || !name) {
+        return [code = compile(expr)](Interpreter& i, Object& scratch) -> const Object& {
+            scratch = code(i);
+            return scratch;
+        };
+    }
+    if (auto depth = interpreter_.resolvedDepth(node)) {
+        return [name, depth = *depth](Interpreter& i, Object&) -> const Object& {
+            return i.env_->getAt(depth, *name);
+        };
+    }
+    return [name](Interpreter&, Object&) -> const Object& {
+        return Interpreter::globals_.get(*name);
+    };
+}
+
+StatementCode Compiler::compile(const Statement& stmt) {
+    return std::visit(*this, stmt);
+}
+
+// Sets up the block's environment as the resolver decided, see
+// Interpreter::operator()(const BlockStatement&, EnvironmentPtr).
+BlockCode Compiler::compileBlock(const BlockStatement& stmt) {
+    std::vector<StatementCode> code;
+    for (const auto& s : stmt.statements) {
+        code.push_back(compile(s));
+    }
+
+    auto it = interpreter_.blocks_.find(&stmt);
+    BlockScope scope = it != interpreter_.blocks_.end() ? it->second : BlockScope::Fresh;
+    switch (scope) {
+        case BlockScope::None:
+            return [code = std::move(code)](Interpreter& i, EnvironmentPtr env) {
+                if (env) {
+                    return runIn(i, std::move(env), code);
+                }
+                return run(i, code);
+            };
+        case BlockScope::Stack:
+            return [code = std::move(code)](Interpreter& i, EnvironmentPtr env) {
+                ScopeGuard guard{ [&i]() {
+                    i.frames_.pop();
+                } };
+                return runIn(i, i.frames_.push(env ? std::move(env) : i.env_), code);
+            };
+        default:
+            return [code = std::move(code)](Interpreter& i, EnvironmentPtr env) {
+                return runIn(i, Environment::make(env ? std::move(env) : i.env_), code);
+            };
+    }
+}
+
+std::vector<Compiler::ExprCode> Compiler::compileArguments(const std::vector<Expr>& arguments) {
+    std::vector<ExprCode> code;
+    for (const Expr& argument : arguments) {
+        code.push_back(compile(argument));
+    }
+    return code;
+}
+
+Compiler::ExprCode Compiler::lookUpVariable(const Token& name, const void* expr) {
+    if (auto depth = interpreter_.resolvedDepth(expr)) {
+        return [&name, depth = *depth](Interpreter& i) -> Object {
+            return i.env_->getAt(depth, name);
+        };
+    }
+    return [&name](Interpreter&) -> Object {
+        return Interpreter::globals_.get(name);
+    };
+}
+
+std::optional<Object> Compiler::run(Interpreter& i, const std::vector<StatementCode>& code) {
+    for (const auto& stmt : code) {
+        if (auto ret = stmt(i)) {
+            return ret;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<Object> Compiler::runIn(Interpreter& i, EnvironmentPtr env, const std::vector<StatementCode>& code) {
+    ScopeGuard guard{ [&i, oldEnvironment = std::exchange(i.env_, std::move(env))]() mutable {
+        i.env_ = std::move(oldEnvironment);
+    } };
+    return run(i, code);
+}
+
+std::vector<Object> Compiler::evaluate(Interpreter& i, const std::vector<ExprCode>& arguments) {
+    std::vector<Object> objects;
+    objects.reserve(arguments.size());
+    for (const auto& argument : arguments) {
+        objects.push_back(argument(i));
+    }
+    return objects;
+}
+
+} // cpplox
\ No newline at end of file
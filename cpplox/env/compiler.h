@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/fwd.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Closure compiler. Turns a resolved program into a tree of callables once,
+// with scope distances, names and operators bound in advance, so that running
+// it never dispatches on the AST variant or looks up the interpreter's side
+// tables. The compiled code runs on the state of the Interpreter it was
+// compiled against, and refers to the program, which must outlive it.
+class Compiler {
+public:
+    using ExprCode = std::function<Object(Interpreter&)>;
+    // Code for an operand that is only looked at, see Interpreter::borrow()
+    using ReadCode = std::function<const Object&(Interpreter&, Object& scratch)>;
+
+    Compiler(Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    ExprCode operator()(const AssignExpr& expr);
+    ExprCode operator()(const BinaryExpr& expr);
+    ExprCode operator()(const CallExpr& expr);
+    ExprCode operator()(const GetExpr& expr);
+    ExprCode operator()(const GroupingExpr& expr);
+    ExprCode operator()(const LiteralExpr& expr);
+    ExprCode operator()(const LogicalExpr& expr);
+    ExprCode operator()(const SetExpr& expr);
+    ExprCode operator()(const SuperExpr& expr);
+    ExprCode operator()(const ThisExpr& expr);
+    ExprCode operator()(const UnaryExpr& expr);
+    ExprCode operator()(const VarExpr& expr);
+    ExprCode operator()(const LocalCompareExpr& expr);
+    ExprCode operator()(const LocalIncrementExpr& expr);
+    ExprCode operator()(const ThisGetExpr& expr);
+    ExprCode operator()(const InvokeExpr& expr);
+
+    StatementCode operator()(const BlockStatement& stmt);
+    StatementCode operator()(const ClassStatement& stmt);
+    StatementCode operator()(const ExprStatement& stmt);
+    StatementCode operator()(const FunctionStatement& stmt);
+    StatementCode operator()(const IfStatement& stmt);
+    StatementCode operator()(const PrintStatement& stmt);
+    StatementCode operator()(const ReturnStatement& stmt);
+    StatementCode operator()(const VarStatement& stmt);
+    StatementCode operator()(const WhileStatement& stmt);
+
+    StatementCode compile(const std::vector<Statement>& stmts);
+    // Body of a function, as Function runs it
+    BlockCode compileBody(const FunctionStatement& stmt);
+
+private:
+    ExprCode compile(const Expr& expr);
+    // Borrows variables and 'this' unless told not to, as the operands
+    // evaluated after this one could assign them
+    ReadCode compileRead(const Expr& expr, bool borrow = true);
+    StatementCode compile(const Statement& stmt);
+    BlockCode compileBlock(const BlockStatement& stmt);
+    std::vector<ExprCode> compileArguments(const std::vector<Expr>& arguments);
+    ExprCode lookUpVariable(const Token& name, const void* expr);
+
+    static std::optional<Object> run(Interpreter& i, const std::vector<StatementCode>& code);
+    static std::optional<Object> runIn(Interpreter& i, EnvironmentPtr env, const std::vector<StatementCode>& code);
+    static std::vector<Object> evaluate(Interpreter& i, const std::vector<ExprCode>& arguments);
+
+    Interpreter& interpreter_;
+};
+
+} // cpplox
\ No newline at end of file
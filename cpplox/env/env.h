@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include <diagnostic/diagnostic.h>
 #include <env/fwd.h>
@@ -14,11 +15,67 @@ public:
     RuntimeError() : std::runtime_error("Runtime error") {}
 };
 
-class Environment : public std::enable_shared_from_this<Environment> {
+// A variable captured by a closure. While the environment declaring it is
+// alive the upvalue refers to its slot there; when that environment goes away
+// the value is closed over and moved into the upvalue.
+class Upvalue : public RefCounted {
+public:
+    explicit Upvalue(Object* location) : location_(location) {}
+
+    Object& get() {
+        return *location_;
+    }
+
+    const Object* location() const {
+        return location_;
+    }
+
+    void close() {
+        if (location_ != &closed_) {
+            closed_ = std::move(*location_);
+            location_ = &closed_;
+        }
+    }
+
+private:
+    // While open, the value belongs to the environment
+    void traverse(const Visitor& visit) override {
+        if (location_ == &closed_) {
+            visitRef(closed_, visit);
+        }
+    }
+
+    void reach(const Visitor& visit) override {
+        visitRef(*location_, visit);
+    }
+
+    // Closed over nil, so that the environment doesn't move a value in
+    void detach() override {
+        closed_ = nullptr;
+        location_ = &closed_;
+    }
+
+    Object* location_;
+    Object closed_;
+};
+
+class Environment : public RefCounted {
 public:
     Environment() = default;
     Environment(EnvironmentPtr enclosing) : enclosing_(std::move(enclosing)) {}
 
+    // A heap environment, recycled from the EnvironmentPool if it has one
+    static EnvironmentPtr make(EnvironmentPtr enclosing = nullptr);
+
+    Environment(const Environment&) = delete;
+    Environment& operator=(const Environment&) = delete;
+
+    ~Environment() {
+        for (auto& upvalue : openUpvalues_) {
+            upvalue->close();
+        }
+    }
+
     // Allows redefinition
     void define(std::string name, Object object) {
         objects_[std::move(name)] = std::move(object);
@@ -37,29 +94,64 @@ public:
     }
 
     Object& getAt(size_t distance, const Token& name) {
-        auto env = ancestor(distance);
-        auto& curObject = env->objects_;
-        if (auto it = curObject.find(name.lexeme()); it != curObject.end()) {
-            return it->second;
+        if (auto object = ancestor(distance)->find(name.lexeme())) {
+            return *object;
         }
         diagnostic_.error(name.line(), "Undefined variable '" + name.lexeme() + "'.");
         throw RuntimeError();
     }
 
     Object& getAt(size_t distance, const std::string& name) {
-        auto env = ancestor(distance);
-        auto& curObject = env->objects_;
-        if (auto it = curObject.find(name); it != curObject.end()) {
-            return it->second;
+        if (auto object = ancestor(distance)->find(name)) {
+            return *object;
         }
         diagnostic_.error(0, "Undefined variable '" + name + "'.");
         throw RuntimeError();
     }
 
-    EnvironmentPtr ancestor(size_t distance) {
-        EnvironmentPtr env = shared_from_this();
+    // Shares the variable `name` declared `distance` levels up with a closure.
+    // Capturing the same variable twice yields the same upvalue.
+    UpvaluePtr captureAt(size_t distance, const std::string& name) {
+        auto env = ancestor(distance);
+        if (auto it = env->upvalues_.find(name); it != env->upvalues_.end()) {
+            return it->second;
+        }
+        auto it = env->objects_.find(name);
+        if (it == env->objects_.end()) {
+            diagnostic_.error(0, "Undefined variable '" + name + "'.");
+            throw RuntimeError();
+        }
+        for (const auto& upvalue : env->openUpvalues_) {
+            if (upvalue->location() == &it->second) {
+                return upvalue;
+            }
+        }
+        return env->openUpvalues_.emplace_back(makeRef<Upvalue>(&it->second));
+    }
+
+    void defineUpvalue(std::string name, UpvaluePtr upvalue) {
+        upvalues_[std::move(name)] = std::move(upvalue);
+    }
+
+    // Finds `name` `distance` levels up, or returns null
+    Object* findAt(size_t distance, const std::string& name) {
+        return ancestor(distance)->find(name);
+    }
+
+    // Finds `name` here or in an enclosing environment
+    Object* lookUp(const std::string& name) {
+        for (Environment* env = this; env; env = env->enclosing_.get()) {
+            if (auto object = env->find(name)) {
+                return object;
+            }
+        }
+        return nullptr;
+    }
+
+    Environment* ancestor(size_t distance) {
+        Environment* env = this;
         for (size_t i = 0; i < distance; i++) {
-            env = env->enclosing_;
+            env = env->enclosing_.get();
         }
         return env;
     }
@@ -79,7 +171,7 @@ public:
     }
 
     void assignAt(size_t distance, const Token& name, Object object) {
-        ancestor(distance)->objects_[name.lexeme()] = std::move(object);
+        getAt(distance, name) = std::move(object);
     }
 
     void print() {
@@ -92,10 +184,185 @@ public:
         return enclosing_;
     }
 
+    void setEnclosing(EnvironmentPtr enclosing) {
+        enclosing_ = std::move(enclosing);
+    }
+
+    // Drops every variable, as if the environment were made anew
+    void clear() {
+        reset();
+    }
+
+    // Readies a frame for reuse. Slots are kept so the next frame declaring
+    // the same names doesn't allocate, unless too many have piled up.
+    void release() {
+        enclosing_ = nullptr;
+        if (objects_.size() > maxRetainedSlots) {
+            objects_.clear();
+            return;
+        }
+        for (auto& [name, object] : objects_) {
+            object = nullptr;
+        }
+    }
+
 private:
+    static constexpr size_t maxRetainedSlots = 8;
+
+    void destroy() override;
+
+    void traverse(const Visitor& visit) override {
+        for (const auto& [name, object] : objects_) {
+            visitRef(object, visit);
+        }
+        for (const auto& [name, upvalue] : upvalues_) {
+            visit(*upvalue);
+        }
+        for (const auto& upvalue : openUpvalues_) {
+            visit(*upvalue);
+        }
+        if (enclosing_) {
+            visit(*enclosing_);
+        }
+    }
+
+    // Upvalues that outlive the environment get their values first
+    void detach() override {
+        reset();
+    }
+
+    // Empties the environment as if it were destroyed and created anew, but
+    // keeps the bucket array of its variables
+    void reset() {
+        for (auto& upvalue : openUpvalues_) {
+            upvalue->close();
+        }
+        openUpvalues_.clear();
+        upvalues_.clear();
+        objects_.clear();
+        enclosing_ = nullptr;
+    }
+
+    Object* find(const std::string& name) {
+        if (auto it = objects_.find(name); it != objects_.end()) {
+            return &it->second;
+        }
+        if (auto it = upvalues_.find(name); it != upvalues_.end()) {
+            return &it->second->get();
+        }
+        return nullptr;
+    }
+
     std::unordered_map<std::string, Object> objects_;
+    // Variables of enclosing scopes captured by a closure
+    std::unordered_map<std::string, UpvaluePtr> upvalues_;
+    // Upvalues still referring to objects_, closed on destruction
+    std::vector<UpvaluePtr> openUpvalues_;
     Diagnostic diagnostic_;
     EnvironmentPtr enclosing_ = nullptr;
+
+    friend class EnvironmentPool;
+};
+
+// Heap environments of calls, blocks, closures and bound methods whose last
+// reference went away, kept for the next one instead of going back to the
+// allocator. Environments are all the same size, so a single free list does;
+// a recycled one comes with its bucket array, unless it held too many
+// variables to be worth keeping.
+class EnvironmentPool {
+public:
+    struct Stats {
+        size_t hits = 0;   // made from a recycled environment
+        size_t misses = 0; // allocated
+    };
+
+    // Environments held at most
+    static constexpr size_t capacity = 1024;
+
+    // The pool of the process, like the globals. Never destroyed, so that
+    // environments released by other statics on exit still find it.
+    static EnvironmentPool& instance() {
+        static auto* pool = new EnvironmentPool;
+        return *pool;
+    }
+
+    EnvironmentPtr make(EnvironmentPtr enclosing) {
+        if (free_.empty()) {
+            stats_.misses++;
+            return makeRef<Environment>(std::move(enclosing));
+        }
+        stats_.hits++;
+        Environment* env = free_.back();
+        free_.pop_back();
+        env->enclosing_ = std::move(enclosing);
+        return EnvironmentPtr(env);
+    }
+
+    // Takes an environment no Ref refers to anymore, or returns false if it
+    // should be freed
+    bool recycle(Environment* env) {
+        if (free_.size() >= capacity || env->objects_.size() > Environment::maxRetainedSlots) {
+            return false;
+        }
+        // Resetting may release other environments into the pool first
+        env->reset();
+        free_.push_back(env);
+        return true;
+    }
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    std::vector<Environment*> free_;
+    Stats stats_;
+};
+
+inline EnvironmentPtr Environment::make(EnvironmentPtr enclosing) {
+    return EnvironmentPool::instance().make(std::move(enclosing));
+}
+
+inline void Environment::destroy() {
+    if (!EnvironmentPool::instance().recycle(this)) {
+        delete this;
+    }
+}
+
+// Where the environment of a call frame lives, as decided by the resolver
+enum class FrameKind {
+    Heap,  // captured by a closure, may outlive the call
+    Stack, // popped off the frame stack on return
+};
+
+// Environments of scopes that no closure captures. They can't outlive the
+// call or block that pushed them, so they are handed out and reclaimed in
+// stack order from contiguous chunks instead of being allocated one by one.
+class FrameStack {
+public:
+    EnvironmentPtr push(EnvironmentPtr enclosing) {
+        if (size_ == chunks_.size() * chunkSize) {
+            auto& chunk = chunks_.emplace_back(new Environment[chunkSize]);
+            for (size_t i = 0; i < chunkSize; i++) {
+                chunk[i].pin();
+            }
+        }
+        EnvironmentPtr frame(&chunks_[size_ / chunkSize][size_ % chunkSize]);
+        frame->setEnclosing(std::move(enclosing));
+        size_++;
+        return frame;
+    }
+
+    void pop() {
+        size_--;
+        chunks_[size_ / chunkSize][size_ % chunkSize].release();
+    }
+
+private:
+    static constexpr size_t chunkSize = 64;
+    // Frames are pinned, as they belong to their chunk
+    std::vector<std::unique_ptr<Environment[]>> chunks_;
+    size_t size_ = 0;
 };
 
 } // cpplox
\ No newline at end of file
@@ -1,19 +1,54 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <variant>
 
+#include <util/ref.h>
+
 namespace cpplox {
 
 class Interpreter;
 class Environment;
 
-using EnvironmentPtr = std::shared_ptr<class Environment>;
-using FunctionPtr = std::shared_ptr<class Function>;
-using NativeFunctionPtr = std::shared_ptr<class NativeFunction>;
-using ClassPtr = std::shared_ptr<class Class>;
-using InstancePtr = std::shared_ptr<class Instance>;
+namespace aot {
+struct Runtime;
+}
+
+// Runtime objects stay on the thread of their interpreter, see RefCounted
+using EnvironmentPtr = Ref<class Environment>;
+using FunctionPtr = Ref<class Function>;
+using NativeFunctionPtr = Ref<class NativeFunction>;
+using ClassPtr = Ref<class Class>;
+using InstancePtr = Ref<class Instance>;
+using UpvaluePtr = Ref<class Upvalue>;
+
+// A number is a double, or an int64_t standing in for one, see number.h
+using Object = std::variant<std::nullptr_t, bool, double, std::string, FunctionPtr, NativeFunctionPtr, ClassPtr, InstancePtr, int64_t>;
+
+// Visits the object a value holds a Ref to, if it holds one
+inline void visitRef(const Object& object, const RefCounted::Visitor& visit) {
+    std::visit([&](const auto& value) {
+        if constexpr (requires { value.base(); }) {
+            if (value) {
+                visit(*value.base());
+            }
+        }
+    }, object);
+}
+
+// How a statement run by the tree-walker finished. A return leaves its value
+// in the interpreter's return slot, see Interpreter::takeReturn().
+enum class Completion : uint8_t {
+    Normal,
+    Return,
+};
 
-using Object = std::variant<std::nullptr_t, bool, double, std::string, FunctionPtr, NativeFunctionPtr, ClassPtr, InstancePtr>;
+// Statements as compiled by the Compiler. Both return a value if the statement
+// returned one; a block runs in the given environment if there is one.
+using StatementCode = std::function<std::optional<Object>(Interpreter&)>;
+using BlockCode = std::function<std::optional<Object>(Interpreter&, EnvironmentPtr)>;
 
 } // cpplox
\ No newline at end of file
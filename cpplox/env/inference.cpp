@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <utility>
+#include <variant>
+
+#include <env/inference.h>
+
+namespace cpplox {
+
+using Type = TypeInference::Type;
+
+Type TypeInference::operator()(const AssignExpr& expr) {
+    Type type = infer(*expr.object);
+    write(expr.name.lexeme(), type);
+    return type;
+}
+
+// Arithmetic other than `+` yields a number or fails. Everything but
+// `and` and `or` has a handler for numbers.
+Type TypeInference::operator()(const BinaryExpr& expr) {
+    Type left = infer(*expr.left);
+    Type right = infer(*expr.right);
+    bool numbers = left == Type::Number && right == Type::Number;
+    prove(&expr, expr.specialization, false, numbers);
+    switch (expr.op.type()) {
+        case TokenType::MINUS:
+        case TokenType::STAR:
+        case TokenType::SLASH:
+            return Type::Number;
+        case TokenType::PLUS:
+            return numbers ? Type::Number : Type::Unknown;
+        default:
+            return Type::Unknown;
+    }
+}
+
+Type TypeInference::operator()(const CallExpr& expr) {
+    infer(*expr.callee);
+    for (const Expr& argument : expr.arguments) {
+        infer(argument);
+    }
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const GetExpr& expr) {
+    infer(*expr.object);
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const GroupingExpr& expr) {
+    return infer(*expr.expr);
+}
+
+Type TypeInference::operator()(const LiteralExpr& expr) {
+    return expr.object.has_value() && std::holds_alternative<double>(*expr.object) ? Type::Number : Type::Unknown;
+}
+
+// The right operand may not run
+Type TypeInference::operator()(const LogicalExpr& expr) {
+    Type left = infer(*expr.left);
+    std::vector<Type> skipped = types_;
+    Type right = infer(*expr.right);
+    types_ = join(std::move(skipped), types_);
+    return left == Type::Number && right == Type::Number ? Type::Number : Type::Unknown;
+}
+
+Type TypeInference::operator()(const SetExpr& expr) {
+    infer(*expr.object);
+    infer(*expr.value);
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const SuperExpr&) {
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const ThisExpr&) {
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const UnaryExpr& expr) {
+    Type right = infer(*expr.right);
+    if (expr.op.type() == TokenType::MINUS) {
+        prove(&expr, expr.specialization, true, right == Type::Number);
+        return Type::Number;
+    }
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const VarExpr& expr) {
+    return read(expr.name.lexeme());
+}
+
+Type TypeInference::operator()(const LocalCompareExpr&) {
+    return Type::Unknown;
+}
+
+// Fails unless the variable holds a number, and then leaves one there
+Type TypeInference::operator()(const LocalIncrementExpr& expr) {
+    write(expr.name, Type::Number);
+    return Type::Number;
+}
+
+Type TypeInference::operator()(const ThisGetExpr&) {
+    return Type::Unknown;
+}
+
+Type TypeInference::operator()(const InvokeExpr& expr) {
+    infer(*expr.object);
+    for (const Expr& argument : expr.arguments) {
+        infer(argument);
+    }
+    return Type::Unknown;
+}
+
+void TypeInference::operator()(const BlockStatement& stmt) {
+    scopes_.emplace_back();
+    for (const Statement& s : stmt.statements) {
+        infer(s);
+    }
+    scopes_.pop_back();
+}
+
+void TypeInference::operator()(const ClassStatement& stmt) {
+    declare(&stmt, stmt.name.lexeme(), Type::Unknown);
+    for (const FunctionStatement& method : stmt.methods) {
+        function(method);
+    }
+}
+
+void TypeInference::operator()(const ExprStatement& stmt) {
+    infer(stmt.expr);
+}
+
+void TypeInference::operator()(const FunctionStatement& stmt) {
+    declare(&stmt, stmt.name.lexeme(), Type::Unknown);
+    function(stmt);
+}
+
+void TypeInference::operator()(const IfStatement& stmt) {
+    infer(stmt.condition);
+    std::vector<Type> skipped = types_;
+    infer(*stmt.thenBranch);
+    std::swap(skipped, types_);
+    if (stmt.elseBranch) {
+        infer(*stmt.elseBranch);
+    }
+    types_ = join(std::move(skipped), types_);
+}
+
+void TypeInference::operator()(const PrintStatement& stmt) {
+    infer(stmt.expr);
+}
+
+void TypeInference::operator()(const ReturnStatement& stmt) {
+    if (stmt.value.has_value()) {
+        infer(*stmt.value);
+    }
+}
+
+void TypeInference::operator()(const VarStatement& stmt) {
+    Type type = stmt.initializer.has_value() ? infer(*stmt.initializer) : Type::Unknown;
+    declare(&stmt, stmt.name.lexeme(), type);
+}
+
+// Runs the body until the types at the condition stop changing. They only
+// ever widen, so that takes a few rounds at most.
+void TypeInference::operator()(const WhileStatement& stmt) {
+    while (true) {
+        std::vector<Type> entry = types_;
+        infer(stmt.condition);
+        std::vector<Type> exit = types_;
+        operator()(*stmt.body);
+        std::vector<Type> next = join(entry, types_);
+        if (next == entry) {
+            types_ = std::move(exit);
+            return;
+        }
+        types_ = std::move(next);
+    }
+}
+
+void TypeInference::infer(const std::vector<Statement>& stmts) {
+    for (const Statement& stmt : stmts) {
+        infer(stmt);
+    }
+    for (const auto& [key, site] : sites_) {
+        (site.negation ? stats_.negations : stats_.binaries)++;
+        interpreter_.resolveProven(site.expr, site.proven);
+        if (site.proven) {
+            *site.specialization = Specialization::Proven;
+            (site.negation ? stats_.provenNegations : stats_.provenBinaries)++;
+        }
+    }
+    sites_.clear();
+}
+
+Type TypeInference::infer(const Expr& expr) {
+    return std::visit(*this, expr);
+}
+
+void TypeInference::infer(const Statement& stmt) {
+    std::visit(*this, stmt);
+}
+
+// Globals aren't tracked
+void TypeInference::declare(const void* declaration, const std::string& name, Type type) {
+    if (scopes_.empty()) {
+        return;
+    }
+    auto [it, inserted] = variables_.try_emplace(declaration, functions_.size());
+    if (inserted) {
+        functions_.push_back(function_);
+        captured_.push_back(false);
+    }
+    size_t variable = it->second;
+    if (types_.size() <= variable) {
+        types_.resize(variable + 1, Type::Unknown);
+    }
+    types_[variable] = captured_[variable] ? Type::Unknown : type;
+    scopes_.back()[name] = variable;
+}
+
+std::optional<size_t> TypeInference::find(const std::string& name) const {
+    for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+        if (auto it = scope->find(name); it != scope->end()) {
+            return it->second;
+        }
+    }
+    return std::nullopt;
+}
+
+Type TypeInference::read(const std::string& name) const {
+    auto variable = find(name);
+    if (!variable || functions_[*variable] != function_ || captured_[*variable] || *variable >= types_.size()) {
+        return Type::Unknown;
+    }
+    return types_[*variable];
+}
+
+// A nested function assigning a variable may run whenever it is called
+void TypeInference::write(const std::string& name, Type type) {
+    auto variable = find(name);
+    if (!variable) {
+        return;
+    }
+    if (functions_[*variable] != function_) {
+        captured_[*variable] = true;
+        return;
+    }
+    types_[*variable] = captured_[*variable] ? Type::Unknown : type;
+}
+
+void TypeInference::function(const FunctionStatement& stmt) {
+    std::vector<Type> outer = types_;
+    const FunctionStatement* enclosing = std::exchange(function_, &stmt);
+    scopes_.emplace_back();
+    for (const Token& param : stmt.params) {
+        declare(&param, param.lexeme(), Type::Unknown);
+    }
+    operator()(*stmt.body);
+    scopes_.pop_back();
+    function_ = enclosing;
+
+    outer.resize(types_.size(), Type::Unknown);
+    types_ = std::move(outer);
+    for (size_t variable = 0; variable < captured_.size(); variable++) {
+        if (captured_[variable]) {
+            types_[variable] = Type::Unknown;
+        }
+    }
+}
+
+void TypeInference::prove(const void* expr, Specialization& specialization, bool negation, bool proven) {
+    auto [it, inserted] = sites_.try_emplace(expr, Site{ expr, &specialization, negation, proven });
+    it->second.proven = it->second.proven && proven;
+}
+
+std::vector<Type> TypeInference::join(std::vector<Type> a, const std::vector<Type>& b) {
+    a.resize(std::max(a.size(), b.size()), Type::Unknown);
+    for (size_t i = 0; i < a.size(); i++) {
+        if (i >= b.size() || a[i] != b[i]) {
+            a[i] = Type::Unknown;
+        }
+    }
+    return a;
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Flow-sensitive type inference over resolved programs. Operators whose
+// operands are numbers on every evaluation are specialized to Proven, which
+// the interpreter evaluates without checking or dispatching on the operands'
+// types. They are also recorded with the interpreter, where the compiler
+// looks them up: it may run while the interpreter respecializes other nodes.
+//
+// Numbers come from number literals, arithmetic, which either yields a
+// number or fails, and locals of the function being analyzed. Globals,
+// parameters and variables of enclosing functions can change behind its
+// back and are unknown; so is a local from the point a nested function that
+// assigns it is declared.
+class TypeInference {
+public:
+    // Number of operator sites analyzed and proven numeric
+    struct Stats {
+        size_t binaries = 0;
+        size_t provenBinaries = 0;
+        size_t negations = 0;
+        size_t provenNegations = 0;
+
+        Stats& operator+=(const Stats& other) {
+            binaries += other.binaries;
+            provenBinaries += other.provenBinaries;
+            negations += other.negations;
+            provenNegations += other.provenNegations;
+            return *this;
+        }
+    };
+
+    enum class Type : uint8_t { Number, Unknown };
+
+    TypeInference(Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    Type operator()(const AssignExpr& expr);
+    Type operator()(const BinaryExpr& expr);
+    Type operator()(const CallExpr& expr);
+    Type operator()(const GetExpr& expr);
+    Type operator()(const GroupingExpr& expr);
+    Type operator()(const LiteralExpr& expr);
+    Type operator()(const LogicalExpr& expr);
+    Type operator()(const SetExpr& expr);
+    Type operator()(const SuperExpr& expr);
+    Type operator()(const ThisExpr& expr);
+    Type operator()(const UnaryExpr& expr);
+    Type operator()(const VarExpr& expr);
+    Type operator()(const LocalCompareExpr& expr);
+    Type operator()(const LocalIncrementExpr& expr);
+    Type operator()(const ThisGetExpr& expr);
+    Type operator()(const InvokeExpr& expr);
+
+    void operator()(const BlockStatement& stmt);
+    void operator()(const ClassStatement& stmt);
+    void operator()(const ExprStatement& stmt);
+    void operator()(const FunctionStatement& stmt);
+    void operator()(const IfStatement& stmt);
+    void operator()(const PrintStatement& stmt);
+    void operator()(const ReturnStatement& stmt);
+    void operator()(const VarStatement& stmt);
+    void operator()(const WhileStatement& stmt);
+
+    void infer(const std::vector<Statement>& stmts);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    Type infer(const Expr& expr);
+    void infer(const Statement& stmt);
+
+    // Variables are numbered by declaration, so that a loop analyzed again
+    // finds the same ones
+    void declare(const void* declaration, const std::string& name, Type type);
+    // The variable `name` refers to, if it is a local of some function
+    std::optional<size_t> find(const std::string& name) const;
+    Type read(const std::string& name) const;
+    void write(const std::string& name, Type type);
+    void function(const FunctionStatement& stmt);
+    // Every visit of a site has to prove it, as loops are analyzed until
+    // their variables' types settle
+    void prove(const void* expr, Specialization& specialization, bool negation, bool proven);
+
+    static std::vector<Type> join(std::vector<Type> a, const std::vector<Type>& b);
+
+    Interpreter& interpreter_;
+    // Names in scope, innermost last
+    std::vector<std::unordered_map<std::string, size_t>> scopes_;
+    std::unordered_map<const void*, size_t> variables_;
+    // Function each variable belongs to, and whether a nested function
+    // assigns it
+    std::vector<const FunctionStatement*> functions_;
+    std::vector<bool> captured_;
+    // Type of each variable at the current point of the program
+    std::vector<Type> types_;
+    // Being analyzed, null at the top level
+    const FunctionStatement* function_ = nullptr;
+
+    struct Site {
+        const void* expr;
+        Specialization* specialization;
+        bool negation;
+        bool proven;
+    };
+    std::unordered_map<const void*, Site> sites_;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
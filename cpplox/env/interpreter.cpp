@@ -1,26 +1,20 @@
 #include <env/interpreter.h>
 
+#include <algorithm>
 #include <variant>
 #include <print>
 
 #include <ast/expr.h>
+#include <env/number.h>
 #include <env/object.h>
 #include <util/scope_guard.h>
 
 namespace {
 
-bool isTruthy(const cpplox::Object& object) {
-    return std::visit([]<typename V>(const V & v) {
-        if constexpr (std::is_same_v<V, std::nullptr_t>) {
-            return false;
-        } else if constexpr (std::is_same_v<V, bool>) {
-            return v;
-        }
-        return true;
-    }, object);
-}
-
 bool isEqual(const cpplox::Object& l, const cpplox::Object& r) {
+    if (l.index() != r.index() && cpplox::isNumber(l) && cpplox::isNumber(r)) {
+        return cpplox::toDouble(l) == cpplox::toDouble(r);
+    }
     return std::visit([](const auto& l, const auto& r) {
         if constexpr (std::is_same_v<decltype(l), decltype(r)>) {
             return l == r;
@@ -36,12 +30,49 @@ namespace cpplox {
 
 Environment Interpreter::globals_ = {};
 
+bool Interpreter::isTruthy(const Object& object) {
+    return std::visit([]<typename V>(const V & v) {
+        if constexpr (std::is_same_v<V, std::nullptr_t>) {
+            return false;
+        } else if constexpr (std::is_same_v<V, bool>) {
+            return v;
+        }
+        return true;
+    }, object);
+}
+
+bool Interpreter::isReadOnly(const Expr& expr) {
+    return std::visit([]<typename T>(const T& e) {
+        if constexpr (std::is_same_v<T, BinaryExpr> || std::is_same_v<T, LogicalExpr>) {
+            return isReadOnly(*e.left) && isReadOnly(*e.right);
+        } else if constexpr (std::is_same_v<T, UnaryExpr>) {
+            return isReadOnly(*e.right);
+        } else if constexpr (std::is_same_v<T, GroupingExpr>) {
+            return isReadOnly(*e.expr);
+        } else {
+            return std::is_same_v<T, LiteralExpr> || std::is_same_v<T, VarExpr> || std::is_same_v<T, ThisExpr>
+                || std::is_same_v<T, LocalCompareExpr>;
+        }
+    }, expr);
+}
+
 Interpreter::Interpreter(Diagnostic& diagnostic, std::ostream& out) : diagnostic_(diagnostic), out_(out) {
-    globals_.define("clock", std::make_shared<NativeFunction>("clock", 0, [](Interpreter*, std::vector<Object>) {
+    // A static, shared by env_ of every interpreter, pinned before the first
+    // Ref to it so that no region takes it in
+    globals_.pin();
+    env_ = Environment::make(EnvironmentPtr(&globals_));
+    globals_.define("clock", makeRef<NativeFunction>("clock", 0, [](Interpreter*, std::vector<Object>) {
         return Object{ static_cast<double>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count()) };
         }));
 }
 
+Interpreter::~Interpreter() {
+    if (releaseSlice_) {
+        ReleaseQueue::instance().resume();
+        ReleaseQueue::instance().drain();
+    }
+}
+
 Object Interpreter::operator()(const AssignExpr& expr) {
     Object object = evaluate(*expr.object);
 
@@ -55,45 +86,175 @@ Object Interpreter::operator()(const AssignExpr& expr) {
     return object;
 }
 
+const Object& Interpreter::borrow(const Expr& expr, Object& scratch) {
+    if (auto* var = std::get_if<VarExpr>(&expr)) {
+        return lookUpVariable(var->name, *var);
+    }
+    if (auto* self = std::get_if<ThisExpr>(&expr)) {
+        return lookUpVariable(self->keyword, *self);
+    }
+    if (auto* grouping = std::get_if<GroupingExpr>(&expr)) {
+        return borrow(*grouping->expr, scratch);
+    }
+    scratch = evaluate(expr);
+    return scratch;
+}
+
 Object Interpreter::operator()(const BinaryExpr& expr) {
-    Object left = evaluate(*expr.left);
-    Object right = evaluate(*expr.right);
+    // The left operand is only borrowed if the right one can't assign it
+    Object leftScratch, rightScratch;
+    const Object& left = isReadOnly(*expr.right) ? borrow(*expr.left, leftScratch) : (leftScratch = evaluate(*expr.left));
+    const Object& right = borrow(*expr.right, rightScratch);
+
+    switch (expr.specialization) {
+        case Specialization::Proven:
+            return binaryNumbers(expr.op.type(), left, right);
+        case Specialization::Number:
+            if (isNumber(left) && isNumber(right)) {
+                return binaryNumbers(expr.op.type(), left, right);
+            }
+            expr.specialization = Specialization::Generic;
+            break;
+        case Specialization::String:
+            if (auto* l = std::get_if<std::string>(&left), *r = std::get_if<std::string>(&right); l && r) {
+                // A temporary left operand is appended to in place
+                if (expr.op.type() == TokenType::PLUS && &left == &leftScratch) {
+                    return std::move(std::get<std::string>(leftScratch).append(*r));
+                }
+                return binaryStrings(expr.op.type(), *l, *r);
+            }
+            expr.specialization = Specialization::Generic;
+            break;
+        case Specialization::Uninitialized:
+            expr.specialization = specializeBinary(expr.op.type(), left, right);
+            break;
+        default:
+            break;
+    }
+    return binaryGeneric(expr.op.type(), expr.op.line(), left, right);
+}
+
+Specialization Interpreter::specializeBinary(TokenType op, const Object& left, const Object& right) {
+    if (isNumber(left) && isNumber(right)) {
+        return Specialization::Number;
+    }
+    bool stringOp = op == TokenType::PLUS || op == TokenType::EQUAL_EQUAL || op == TokenType::BANG_EQUAL;
+    if (stringOp && std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
+        return Specialization::String;
+    }
+    return Specialization::Generic;
+}
+
+Object Interpreter::binaryNumbers(TokenType op, const Object& left, const Object& right) {
+    if (auto* l = std::get_if<int64_t>(&left), *r = std::get_if<int64_t>(&right); l && r) {
+        return binaryIntegers(op, *l, *r);
+    }
+    return binaryNumbers(op, toDouble(left), toDouble(right));
+}
+
+// Falls back to doubles when the result isn't an integer
+Object Interpreter::binaryIntegers(TokenType op, int64_t left, int64_t right) {
+    std::optional<int64_t> result;
+    switch (op) {
+        case TokenType::BANG_EQUAL:
+            return left != right;
+        case TokenType::EQUAL_EQUAL:
+            return left == right;
+        case TokenType::GREATER:
+            return left > right;
+        case TokenType::GREATER_EQUAL:
+            return left >= right;
+        case TokenType::LESS:
+            return left < right;
+        case TokenType::LESS_EQUAL:
+            return left <= right;
+        case TokenType::MINUS:
+            result = addIntegers(left, -right);
+            break;
+        case TokenType::SLASH:
+            result = divideIntegers(left, right);
+            break;
+        case TokenType::STAR:
+            result = multiplyIntegers(left, right);
+            break;
+        case TokenType::PLUS:
+            result = addIntegers(left, right);
+            break;
+        default:
+            std::unreachable();
+    }
+    if (result.has_value()) {
+        return *result;
+    }
+    return binaryNumbers(op, static_cast<double>(left), static_cast<double>(right));
+}
+
+Object Interpreter::binaryNumbers(TokenType op, double left, double right) {
+    switch (op) {
+        case TokenType::BANG_EQUAL:
+            return left != right;
+        case TokenType::EQUAL_EQUAL:
+            return left == right;
+        case TokenType::GREATER:
+            return left > right;
+        case TokenType::GREATER_EQUAL:
+            return left >= right;
+        case TokenType::LESS:
+            return left < right;
+        case TokenType::LESS_EQUAL:
+            return left <= right;
+        case TokenType::MINUS:
+            return left - right;
+        case TokenType::SLASH:
+            return left / right;
+        case TokenType::STAR:
+            return left * right;
+        case TokenType::PLUS:
+            return left + right;
+        default:
+            break;
+    }
+    std::unreachable();
+}
+
+Object Interpreter::binaryStrings(TokenType op, const std::string& left, const std::string& right) {
+    switch (op) {
+        case TokenType::BANG_EQUAL:
+            return left != right;
+        case TokenType::EQUAL_EQUAL:
+            return left == right;
+        case TokenType::PLUS:
+            return left + right;
+        default:
+            break;
+    }
+    std::unreachable();
+}
 
-    switch (expr.op.type()) {
+Object Interpreter::binaryGeneric(TokenType op, int line, const Object& left, const Object& right) {
+    switch (op) {
         case TokenType::BANG_EQUAL:
             return !isEqual(left, right);
         case TokenType::EQUAL_EQUAL:
             return isEqual(left, right);
         case TokenType::GREATER:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) > std::get<double>(right);
         case TokenType::GREATER_EQUAL:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) >= std::get<double>(right);
         case TokenType::LESS:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) < std::get<double>(right);
         case TokenType::LESS_EQUAL:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) <= std::get<double>(right);
         case TokenType::MINUS:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) - std::get<double>(right);
         case TokenType::SLASH:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) / std::get<double>(right);
         case TokenType::STAR:
-            checkNumberOperands(expr.op, left, right);
-            return std::get<double>(left) * std::get<double>(right);
+            checkNumberOperands(line, left, right);
+            return binaryNumbers(op, left, right);
         case TokenType::PLUS: {
             // operator+ is overloaded for numbers and strings
-            if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
-                return std::get<double>(left) + std::get<double>(right);
+            if (isNumber(left) && isNumber(right)) {
+                return binaryNumbers(op, left, right);
             }
             if (std::holds_alternative<std::string>(left) && std::holds_alternative<std::string>(right)) {
                 return std::get<std::string>(left) + std::get<std::string>(right);
             }
-            error(expr.op, "Operands must be two numbers or two strings.");
+            error(line, "Operands must be two numbers or two strings.");
             throw RuntimeError();
         }
         default:
@@ -111,25 +272,48 @@ Object Interpreter::operator()(const CallExpr& expr) {
         arguments.push_back(evaluate(argument));
     }
 
+    return callValue(callee, std::move(arguments), expr.paren);
+}
+
+Object Interpreter::callValue(const Object& callee, std::vector<Object> arguments, const Token& paren) {
     return std::visit([&]<typename T>(const T & v) -> Object {
         if constexpr (is_callable_v<T>) {
             if (arguments.size() != v->arity()) {
-                error(expr.paren, std::format("Expected {} arguments but got {}.", v->arity(), arguments.size()));
+                error(paren, std::format("Expected {} arguments but got {}.", v->arity(), arguments.size()));
                 throw RuntimeError();
             }
             return v->call(this, std::move(arguments));
         } else {
-            error(expr.paren, "Can only call functions.");
+            error(paren, "Can only call functions.");
             throw RuntimeError();
         }
     }, callee);
-    // Check arity
 }
 
 Object Interpreter::operator()(const GetExpr& expr) {
-    Object object = evaluate(*expr.object);
+    Object scratch;
+    const Object& object = borrow(*expr.object, scratch);
     if (std::holds_alternative<InstancePtr>(object)) {
-        auto instance = std::get<InstancePtr>(object);
+        const auto& instance = std::get<InstancePtr>(object);
+        if (expr.specialization == Specialization::Monomorphic) {
+            if (instance->class_ == expr.cachedClass) {
+                // Fields shadow methods.
+                if (auto it = instance->fields_.find(expr.name.lexeme()); it != instance->fields_.end()) {
+                    return it->second;
+                }
+                return expr.cachedMethod->bind(instance);
+            }
+            expr.specialization = Specialization::Generic;
+            expr.cachedClass = nullptr;
+            expr.cachedMethod = nullptr;
+        } else if (expr.specialization == Specialization::Uninitialized && !instance->fields_.contains(expr.name.lexeme())) {
+            // Only method lookups are worth caching; fields live on the instance.
+            if (auto method = instance->class_->findMethod(expr.name.lexeme())) {
+                expr.specialization = Specialization::Monomorphic;
+                expr.cachedClass = instance->class_;
+                expr.cachedMethod = method;
+            }
+        }
         auto ret = instance->get(expr.name);
         if (ret.has_value()) {
             return ret.value();
@@ -146,6 +330,9 @@ Object Interpreter::operator()(const GroupingExpr& expr) {
 }
 
 Object Interpreter::operator()(const LiteralExpr& expr) {
+    if (auto* value = expr.object ? std::get_if<double>(&*expr.object) : nullptr) {
+        return number(*value);
+    }
     if (expr.object.has_value()) {
         return  std::visit([](const auto& l) {return Object{ l };}, *expr.object);
     }
@@ -153,7 +340,8 @@ Object Interpreter::operator()(const LiteralExpr& expr) {
 }
 
 Object Interpreter::operator()(const LogicalExpr& expr) {
-    Object left = evaluate(*expr.left);
+    Object scratch;
+    const Object& left = borrow(*expr.left, scratch);
 
     if (expr.op.type() == TokenType::OR) {
         if (isTruthy(left)) { return left; }
@@ -175,9 +363,8 @@ Object Interpreter::operator()(const SetExpr& expr) {
 }
 
 Object Interpreter::operator()(const SuperExpr& expr) {
-    auto distance = locals_[&expr];
-    auto superclass = env_->getAt(distance, "super");
-    auto instance = env_->getAt(distance - 1, "this");
+    auto superclass = env_->getAt(locals_[&expr], "super");
+    auto instance = env_->getAt(locals_[&expr.method], "this");
     auto method = std::get<ClassPtr>(superclass)->findMethod(expr.method.lexeme());
     if (!method) {
         error(expr.method, "Undefined property '" + expr.method.lexeme() + "'.");
@@ -191,12 +378,23 @@ Object Interpreter::operator()(const ThisExpr& expr) {
 }
 
 Object Interpreter::operator()(const UnaryExpr& expr) {
-    Object right = evaluate(*expr.right);
+    Object scratch;
+    const Object& right = borrow(*expr.right, scratch);
     if (expr.op.type() == TokenType::BANG) {
         return !isTruthy(right);
     } else if (expr.op.type() == TokenType::MINUS) {
-        checkNumberOperands(expr.op, right);
-        return -std::get<double>(right);
+        if (expr.specialization == Specialization::Proven) {
+            return negate(right);
+        } else if (expr.specialization == Specialization::Number) {
+            if (isNumber(right)) {
+                return negate(right);
+            }
+            expr.specialization = Specialization::Generic;
+        } else if (expr.specialization == Specialization::Uninitialized) {
+            expr.specialization = isNumber(right) ? Specialization::Number : Specialization::Generic;
+        }
+        checkNumberOperands(expr.op.line(), right);
+        return negate(right);
     }
     std::unreachable();
 }
@@ -205,21 +403,120 @@ Object Interpreter::operator()(const VarExpr& expr) {
     return lookUpVariable(expr.name, expr);
 }
 
-std::optional<Object> Interpreter::operator()(const BlockStatement& stmt, EnvironmentPtr env) {
-    EnvironmentPtr blockEnvironment = env ? std::make_shared<Environment>(env) : std::make_shared<Environment>(env_);
-    ScopeGuard guard{ [this, oldEnvironment = std::exchange(env_, blockEnvironment)]() {
-        env_ = oldEnvironment;
-    } };
+Object Interpreter::operator()(const LocalCompareExpr& expr) {
+    const Object& left = env_->getAt(expr.leftDepth, expr.left);
+    const Object& right = env_->getAt(expr.rightDepth, expr.right);
+    if (auto* l = std::get_if<int64_t>(&left), *r = std::get_if<int64_t>(&right); l && r) {
+        return binaryIntegers(expr.op, *l, *r);
+    }
+    if (isNumber(left) && isNumber(right)) {
+        return binaryNumbers(expr.op, toDouble(left), toDouble(right));
+    }
+    return binaryGeneric(expr.op, expr.line, left, right);
+}
 
-    for (const Statement& statement : stmt.statements) {
-        if (auto ret = execute(statement)) {
-            return ret;
+Object Interpreter::operator()(const LocalIncrementExpr& expr) {
+    Object& object = env_->getAt(expr.depth, expr.name);
+    if (auto* integer = std::get_if<int64_t>(&object)) {
+        increment(object, *integer, expr.op == TokenType::PLUS, expr.step);
+        return object;
+    }
+    if (auto* number = std::get_if<double>(&object)) {
+        *number = expr.op == TokenType::PLUS ? *number + expr.step : *number - expr.step;
+        return object;
+    }
+    // Reports the operand error
+    return binaryGeneric(expr.op, expr.line, object, expr.step);
+}
+
+Object Interpreter::operator()(const ThisGetExpr& expr) {
+    auto& instance = std::get<InstancePtr>(env_->getAt(expr.depth, "this"));
+    if (auto it = instance->fields_.find(expr.name); it != instance->fields_.end()) {
+        return it->second;
+    }
+    if (auto method = instance->class_->findMethod(expr.name)) {
+        return method->bind(instance);
+    }
+    error(expr.line, "Undefined property '" + expr.name + "'.");
+    throw RuntimeError();
+}
+
+Object Interpreter::operator()(const InvokeExpr& expr) {
+    // The arguments run before the method takes the instance
+    Object scratch;
+    bool borrowed = std::ranges::all_of(expr.arguments, isReadOnly);
+    const Object& object = borrowed ? borrow(*expr.object, scratch) : (scratch = evaluate(*expr.object));
+    auto* instance = std::get_if<InstancePtr>(&object);
+    if (!instance) {
+        error(expr.name, "Only instances have properties.");
+        throw RuntimeError();
+    }
+
+    // Fields shadow methods.
+    if (auto it = (*instance)->fields_.find(expr.name.lexeme()); it != (*instance)->fields_.end()) {
+        Object callee = it->second;
+        std::vector<Object> arguments;
+        for (const Expr& argument : expr.arguments) {
+            arguments.push_back(evaluate(argument));
         }
+        return callValue(callee, std::move(arguments), expr.paren);
+    }
+
+    FunctionPtr method = lookUpMethod(expr, *instance);
+    std::vector<Object> arguments;
+    for (const Expr& argument : expr.arguments) {
+        arguments.push_back(evaluate(argument));
+    }
+    if (arguments.size() != method->arity()) {
+        error(expr.paren, std::format("Expected {} arguments but got {}.", method->arity(), arguments.size()));
+        throw RuntimeError();
     }
-    return std::nullopt;
+    // Calls the method with 'this' bound, without creating the bound method.
+    return method->invoke(this, *instance, std::move(arguments));
 }
 
-std::optional<Object> Interpreter::operator()(const ClassStatement& stmt) {
+// The method an invocation calls, through the node's inline cache
+FunctionPtr Interpreter::lookUpMethod(const InvokeExpr& expr, const InstancePtr& instance) {
+    if (expr.specialization == Specialization::Monomorphic && instance->class_ == expr.cachedClass) {
+        return expr.cachedMethod;
+    }
+    auto method = instance->class_->findMethod(expr.name.lexeme());
+    if (!method) {
+        error(expr.name, "Undefined property '" + expr.name.lexeme() + "'.");
+        throw RuntimeError();
+    }
+    if (expr.specialization == Specialization::Uninitialized) {
+        expr.specialization = Specialization::Monomorphic;
+        expr.cachedClass = instance->class_;
+        expr.cachedMethod = method;
+    } else if (expr.specialization == Specialization::Monomorphic) {
+        expr.specialization = Specialization::Generic;
+        expr.cachedClass = nullptr;
+        expr.cachedMethod = nullptr;
+    }
+    return method;
+}
+
+Completion Interpreter::operator()(const BlockStatement& stmt, EnvironmentPtr env) {
+    auto it = blocks_.find(&stmt);
+    if (it == blocks_.end() || it->second == BlockScope::Fresh) {
+        return executeBlock(stmt.statements, Environment::make(env ? std::move(env) : env_));
+    }
+
+    if (it->second == BlockScope::None) {
+        if (env) {
+            return executeBlock(stmt.statements, std::move(env));
+        }
+        return executeBlock(stmt.statements);
+    }
+
+    ScopeGuard guard{ [this]() {
+        frames_.pop();
+    } };
+    return executeBlock(stmt.statements, frames_.push(env ? std::move(env) : env_));
+}
+
+Completion Interpreter::operator()(const ClassStatement& stmt) {
     std::optional<Object> superclass;
     if (stmt.superclass.has_value()) {
         superclass = operator()(*stmt.superclass);
@@ -230,91 +527,211 @@ std::optional<Object> Interpreter::operator()(const ClassStatement& stmt) {
     }
     env_->define(stmt.name.lexeme(), {});
 
+    EnvironmentPtr closure = makeClosure(&stmt);
     if (superclass.has_value()) {
-        env_ = std::make_shared<Environment>(env_);
-        env_->define("super", std::get<ClassPtr>(*superclass));
+        closure = Environment::make(std::move(closure));
+        closure->define("super", std::get<ClassPtr>(*superclass));
     }
 
     std::unordered_map<std::string, FunctionPtr> methods;
     for (const FunctionStatement& method : stmt.methods) {
-        methods[method.name.lexeme()] = std::make_shared<Function>(env_, method, method.name.lexeme() == "init");
+        methods[method.name.lexeme()] = makeFunction(closure, method, method.name.lexeme() == "init", frameKind(method));
     }
 
     if (superclass.has_value()) {
-        auto klass = std::make_shared<Class>(stmt.name.lexeme(), std::move(methods), std::get<ClassPtr>(*superclass));
-        env_ = env_->enclosing();
-        env_->assign(stmt.name, std::move(klass));
-        return std::nullopt;
+        env_->assign(stmt.name, makeRef<Class>(stmt.name.lexeme(), std::move(methods), std::get<ClassPtr>(*superclass), constructor(stmt)));
+        return Completion::Normal;
     }
-    env_->assign(stmt.name, std::make_shared<Class>(stmt.name.lexeme(), std::move(methods)));
-    return std::nullopt;
+    env_->assign(stmt.name, makeRef<Class>(stmt.name.lexeme(), std::move(methods), nullptr, constructor(stmt)));
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const ExprStatement& stmt) {
+Completion Interpreter::operator()(const ExprStatement& stmt) {
     evaluate(stmt.expr);
-    return std::nullopt;
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const FunctionStatement& stmt) {
-    env_->define(stmt.name.lexeme(), std::make_shared<Function>(env_, stmt, false));
-    return std::nullopt;
+Completion Interpreter::operator()(const FunctionStatement& stmt) {
+    // Declared first so that a recursive function can capture itself.
+    env_->define(stmt.name.lexeme(), {});
+    env_->define(stmt.name.lexeme(), makeFunction(makeClosure(&stmt), stmt, false, frameKind(stmt)));
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const IfStatement& stmt) {
-    if (isTruthy(evaluate(stmt.condition))) {
+Completion Interpreter::operator()(const IfStatement& stmt) {
+    Object scratch;
+    bool taken = isTruthy(borrow(stmt.condition, scratch));
+    if (path_) {
+        (*path_)[&stmt] = taken;
+    }
+    if (taken) {
         return execute(*stmt.thenBranch);
     } else if (stmt.elseBranch) {
         return execute(*stmt.elseBranch);
     }
-    return std::nullopt;
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const PrintStatement& stmt) {
-    Object object = evaluate(stmt.expr);
-    std::print(out_, "{}\n", object);
-    return std::nullopt;
+Completion Interpreter::operator()(const PrintStatement& stmt) {
+    Object scratch;
+    std::print(out_, "{}\n", borrow(stmt.expr, scratch));
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const ReturnStatement& stmt) {
-    std::optional<Object> value;
-    if (stmt.value.has_value()) {
-        value = evaluate(*stmt.value);
-    }
-    return value;
+Completion Interpreter::operator()(const ReturnStatement& stmt) {
+    return_ = stmt.value.has_value() ? evaluate(*stmt.value) : nullptr;
+    return Completion::Return;
 }
 
-std::optional<Object> Interpreter::operator()(const VarStatement& stmt) {
+Completion Interpreter::operator()(const VarStatement& stmt) {
     Object object;
     if (stmt.initializer.has_value()) {
         object = evaluate(*stmt.initializer);
     }
     env_->define(stmt.name.lexeme(), std::move(object));
-    return std::nullopt;
+    return Completion::Normal;
 }
 
-std::optional<Object> Interpreter::operator()(const WhileStatement& stmt) {
-    while (isTruthy(evaluate(stmt.condition))) {
-        auto ret = operator()(*stmt.body);
-        if (ret.has_value()) {
-            return ret;
+Completion Interpreter::operator()(const WhileStatement& stmt) {
+    Jit::Trace* trace = jit_.trace(stmt);
+    const Tiering::Slot<StatementCode>* compiled = nullptr;
+    size_t iterations = 0;
+    while (true) {
+        // On-stack replacement: the compiled loop carries on in the same
+        // environment, from the condition.
+        if (compiled) {
+            if (auto* code = compiled->load(std::memory_order_acquire)) {
+                return complete((*code)(*this));
+            }
+        }
+        Object scratch;
+        if (!isTruthy(borrow(stmt.condition, scratch))) {
+            break;
+        }
+        if (trace) {
+            // A traced condition has no side effects, so the trace can
+            // start over with it. Side exits resume here, at the body.
+            if (jit_.run(*trace, *env_, depthLeft()) == Jit::TraceExit::Finished) {
+                return Completion::Normal;
+            }
+            if (trace->blacklisted) {
+                trace = nullptr;
+            }
+        } else if (++iterations == Jit::traceThreshold && !path_ && !jit_.traced(stmt)) {
+            // Records this iteration, then runs the rest of the loop natively
+            if (recordIteration(stmt) == Completion::Return) {
+                return Completion::Return;
+            }
+            trace = jit_.trace(stmt);
+            continue;
+        } else if (iterations == osrThreshold && tiering_) {
+            compiled = &tiering_->compile(stmt);
+        }
+        if (operator()(*stmt.body) == Completion::Return) {
+            return Completion::Return;
+        }
+        safePoint();
+    }
+    return Completion::Normal;
+}
+
+Completion Interpreter::recordIteration(const WhileStatement& stmt) {
+    Jit::Path path;
+    Completion completion;
+    {
+        path_ = &path;
+        ScopeGuard guard{ [this]() {
+            path_ = nullptr;
+        } };
+        completion = operator()(*stmt.body);
+    }
+    if (completion == Completion::Normal) {
+        jit_.compileTrace(stmt, path, *this);
+    }
+    return completion;
+}
+
+Completion Interpreter::complete(std::optional<Object> ret) {
+    if (!ret.has_value()) {
+        return Completion::Normal;
+    }
+    return_ = *std::move(ret);
+    return Completion::Return;
+}
+
+FunctionPtr Interpreter::makeFunction(EnvironmentPtr closure, const FunctionStatement& declaration, bool isInit, FrameKind frame, const BlockCode* code) {
+    auto function = makeRef<Function>(std::move(closure), declaration, isInit, frame, code);
+    if (memoCapacity_ && isPure(declaration)) {
+        auto& memo = memos_[&declaration];
+        if (!memo) {
+            memo = std::make_shared<Memo>(*memoCapacity_);
+        }
+        function->memo_ = memo;
+        function->jittable_ = false;
+    }
+    auto it = warm_.find(&declaration);
+    if (it == warm_.end()) {
+        return function;
+    }
+    // Past the thresholds, so the first call goes to the code the function
+    // ended up in
+    if (it->second.tiered) {
+        function->calls_ = tierThreshold;
+        if (!code) {
+            function->tier_ = tierUp(declaration);
+        }
+    }
+    if (it->second.compiled == true) {
+        function->calls_ = jitThreshold;
+    } else if (it->second.compiled == false) {
+        function->jittable_ = false;
+    }
+    return function;
+}
+
+Completion Interpreter::executeBlock(const std::vector<Statement>& statements) {
+    for (const Statement& statement : statements) {
+        if (execute(statement) == Completion::Return) {
+            return Completion::Return;
         }
     }
-    return std::nullopt;
+    return Completion::Normal;
+}
+
+Completion Interpreter::executeBlock(const std::vector<Statement>& statements, EnvironmentPtr env) {
+    ScopeGuard guard{ [this, oldEnvironment = std::exchange(env_, std::move(env))]() mutable {
+        env_ = std::move(oldEnvironment);
+    } };
+    return executeBlock(statements);
+}
+
+// The closure of a function or class only holds the variables it captures,
+// not the environments they are declared in.
+EnvironmentPtr Interpreter::makeClosure(const void* declaration) {
+    auto it = captures_.find(declaration);
+    if (it == captures_.end() || it->second.empty()) {
+        return nullptr;
+    }
+    auto closure = Environment::make();
+    for (const auto& [name, distance] : it->second) {
+        closure->defineUpvalue(name, env_->captureAt(distance, name));
+    }
+    return closure;
 }
 
-void Interpreter::checkNumberOperands(const Token& op, const Object& operand) {
-    if (std::holds_alternative<double>(operand)) {
+void Interpreter::checkNumberOperands(int line, const Object& operand) {
+    if (isNumber(operand)) {
         return;
     }
-    error(op, "Operands must be a number.");
+    error(line, "Operands must be a number.");
     throw RuntimeError();
 }
 
-void Interpreter::checkNumberOperands(const Token& op, const Object& left, const Object& right) {
-    if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
+void Interpreter::checkNumberOperands(int line, const Object& left, const Object& right) {
+    if (isNumber(left) && isNumber(right)) {
         return;
     }
-    error(op, "Operands must be numbers.");
+    error(line, "Operands must be numbers.");
     throw RuntimeError();
 }
 
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <format>
 #include <memory>
 #include <optional>
 #include <print>
 #include <unordered_map>
+#include <unordered_set>
 #include <variant>
 #include <iostream>
 
@@ -15,23 +17,78 @@
 #include <env/fwd.h>
 #include <env/object.h>
 #include <diagnostic/diagnostic.h>
+#include <env/tiering.h>
+#include <jit/jit.h>
 
 namespace cpplox {
 
+// How a block sets up its environment, as decided by the resolver
+enum class BlockScope {
+    None,  // declares nothing and runs in the enclosing environment
+    Fresh, // captured by a closure, gets a new environment on every entry
+    Stack, // takes its environment from the frame stack
+};
+
+// A variable a function or class captures, `distance` scopes up from where
+// it is declared
+struct Capture {
+    std::string name;
+    size_t distance;
+};
+
+// How far a function got on an earlier run, as recorded in a Profile
+struct FunctionProfile {
+    bool tiered = false;
+    // Whether the JIT compiled it, if it got that hot
+    std::optional<bool> compiled;
+};
+
 // Tree-walk interpreter
 class Interpreter {
     Object evaluate(const Expr& expr) {
+        checkStack();
         return std::visit(*this, expr);
     }
 
-    std::optional<Object> execute(const Statement& stmt) {
+    // Evaluates an operand that is only looked at, not stored. Variables and
+    // 'this' are borrowed from their environment instead of copied; any other
+    // value ends up in `scratch`.
+    const Object& borrow(const Expr& expr, Object& scratch);
+
+    Completion execute(const Statement& stmt) {
+        checkStack();
         return std::visit(*this, stmt);
     }
 
-    void checkNumberOperands(const Token& op, const Object& operand);
-    void checkNumberOperands(const Token& op, const Object& left, const Object& right);
+    Completion executeBlock(const std::vector<Statement>& statements);
+    Completion executeBlock(const std::vector<Statement>& statements, EnvironmentPtr env);
+    EnvironmentPtr makeClosure(const void* declaration);
+
+    // Handlers BinaryExpr nodes are specialized to
+    Specialization specializeBinary(TokenType op, const Object& left, const Object& right);
+    // Operands are numbers, either kind, see number.h
+    Object binaryNumbers(TokenType op, const Object& left, const Object& right);
+    Object binaryIntegers(TokenType op, int64_t left, int64_t right);
+    Object binaryNumbers(TokenType op, double left, double right);
+    Object binaryStrings(TokenType op, const std::string& left, const std::string& right);
+    Object binaryGeneric(TokenType op, int line, const Object& left, const Object& right);
+
+    Object callValue(const Object& callee, std::vector<Object> arguments, const Token& paren);
+    FunctionPtr lookUpMethod(const InvokeExpr& expr, const InstancePtr& instance);
+    // Runs one iteration of a hot loop while recording its path, and traces it
+    Completion recordIteration(const WhileStatement& stmt);
+    // Hands what compiled code returned over to the return slot
+    Completion complete(std::optional<Object> ret);
+
+    static bool isTruthy(const Object& object);
+    // Whether evaluating `expr` can't assign a variable or run user code,
+    // which could change or free a value borrowed before it
+    static bool isReadOnly(const Expr& expr);
+
+    void checkNumberOperands(int line, const Object& operand);
+    void checkNumberOperands(int line, const Object& left, const Object& right);
     template <typename T> requires is_contained_in_v<T, Expr>
-    Object lookUpVariable(const Token& name, const T& expr) {
+    const Object& lookUpVariable(const Token& name, const T& expr) {
         if (auto it = locals_.find(&expr); it != locals_.end()) {
             return env_->getAt(it->second, name);
         } else {
@@ -41,6 +98,7 @@ class Interpreter {
 
 public:
     Interpreter(Diagnostic& diagnostic, std::ostream& out = std::cout);
+    ~Interpreter();
 
     Object operator()(const AssignExpr& expr);
     Object operator()(const BinaryExpr& expr);
@@ -54,16 +112,20 @@ public:
     Object operator()(const ThisExpr& expr);
     Object operator()(const UnaryExpr& expr);
     Object operator()(const VarExpr& expr);
+    Object operator()(const LocalCompareExpr& expr);
+    Object operator()(const LocalIncrementExpr& expr);
+    Object operator()(const ThisGetExpr& expr);
+    Object operator()(const InvokeExpr& expr);
 
-    std::optional<Object> operator()(const BlockStatement& stmt, EnvironmentPtr closure = nullptr);;
-    std::optional<Object> operator()(const ClassStatement& stmt);
-    std::optional<Object> operator()(const ExprStatement& stmt);
-    std::optional<Object> operator()(const FunctionStatement& stmt);
-    std::optional<Object> operator()(const IfStatement& stmt);
-    std::optional<Object> operator()(const PrintStatement& stmt);
-    std::optional<Object> operator()(const ReturnStatement& stmt);
-    std::optional<Object> operator()(const VarStatement& stmt);
-    std::optional<Object> operator()(const WhileStatement& stmt);
+    Completion operator()(const BlockStatement& stmt, EnvironmentPtr closure = nullptr);
+    Completion operator()(const ClassStatement& stmt);
+    Completion operator()(const ExprStatement& stmt);
+    Completion operator()(const FunctionStatement& stmt);
+    Completion operator()(const IfStatement& stmt);
+    Completion operator()(const PrintStatement& stmt);
+    Completion operator()(const ReturnStatement& stmt);
+    Completion operator()(const VarStatement& stmt);
+    Completion operator()(const WhileStatement& stmt);
 
     std::optional<Object> interpretExpr(const Expr& expr) {
         try {
@@ -78,27 +140,314 @@ public:
         try {
             for (const Statement& statement : statements) {
                 execute(statement);
+                safePoint();
             }
         } catch (const RuntimeError& e) {
             // no-op
         }
     }
 
+    // Runs a program compiled by the Compiler
+    void interpret(const StatementCode& program) {
+        try {
+            program(*this);
+        } catch (const RuntimeError& e) {
+            // no-op
+        }
+    }
+
+    // The value of the return statement that completed last, moved out of
+    // the slot
+    Object takeReturn() {
+        return std::move(return_);
+    }
+
     void error(const Token& token, std::string_view message) {
         diagnostic_.error(token.line(), message);
     }
 
+    void error(int line, std::string_view message) {
+        diagnostic_.error(line, message);
+    }
+
     template <typename T> requires is_contained_in_v<T, Expr>
     void resolve(const T& expr, size_t depth) {
         locals_[&expr] = depth;
     }
 
+    std::optional<size_t> resolvedDepth(const void* expr) const {
+        if (auto it = locals_.find(expr); it != locals_.end()) {
+            return it->second;
+        }
+        return std::nullopt;
+    }
+
+    // Drops the distance of a node the Optimizer fused away, so that a node
+    // allocated at the same address later doesn't pick it up.
+    void forget(const void* expr) {
+        locals_.erase(expr);
+    }
+
+    void resolve(const BlockStatement& stmt, BlockScope scope) {
+        blocks_[&stmt] = scope;
+    }
+
+    BlockScope blockScope(const BlockStatement& stmt) const {
+        auto it = blocks_.find(&stmt);
+        return it != blocks_.end() ? it->second : BlockScope::Fresh;
+    }
+
+    void resolve(const FunctionStatement& stmt, FrameKind frame) {
+        frameKinds_[&stmt] = frame;
+    }
+
+    FrameKind frameKind(const FunctionStatement& stmt) const {
+        auto it = frameKinds_.find(&stmt);
+        return it != frameKinds_.end() ? it->second : FrameKind::Heap;
+    }
+
+    // Environment for a call to a function with the given frame kind, popped
+    // off the frame stack by popFrame() if it was taken from there. Fails if
+    // calls are nested too deep already, see limitDepth() and limitStack().
+    EnvironmentPtr pushFrame(FrameKind frame, EnvironmentPtr closure, int line) {
+        callLine_ = line;
+        if (depth_ == maxDepth_) {
+            error(line, "Stack overflow.");
+            throw RuntimeError();
+        }
+        checkStack();
+        depth_++;
+        if (frame == FrameKind::Stack) {
+            return frames_.push(std::move(closure));
+        }
+        return Environment::make(std::move(closure));
+    }
+
+    void popFrame(FrameKind frame) {
+        depth_--;
+        if (frame == FrameKind::Stack) {
+            frames_.pop();
+        }
+    }
+
+    // Calls nested deeper than `depth` fail with a runtime error. Unlimited
+    // by default, which leaves it to the native stack.
+    void limitDepth(size_t depth) {
+        maxDepth_ = depth;
+    }
+
+    // Native stack kept free at the bottom of a limited stack: room for what
+    // runs between two checks, like a call's expressions in compiled code,
+    // and for reporting the error
+    static constexpr size_t stackMargin = 256 * 1024;
+
+    // Calls and evaluation fail with a runtime error once the native stack
+    // gets within stackMargin of `bottom`, the lowest address of the stack
+    // the program runs on, so that calls taking more of it than limitDepth()
+    // allowed for fail too rather than run off its end. Null lifts the limit.
+    void limitStack(const void* bottom) {
+        stackLimit_ = bottom ? reinterpret_cast<uintptr_t>(bottom) + stackMargin : 0;
+    }
+
+    // Reported at the line of the latest call. The address of a local is
+    // where the stack got to, and unlike the frame address doesn't make the
+    // caller set up a frame pointer.
+    void checkStack() {
+        char top;
+        if (reinterpret_cast<uintptr_t>(&top) < stackLimit_) [[unlikely]] {
+            error(callLine_, "Stack overflow.");
+            throw RuntimeError();
+        }
+    }
+
+    // Calls that may still be nested in the ones in progress
+    size_t depthLeft() const {
+        return maxDepth_ - depth_;
+    }
+
+    // Runs a hot function as native code, if the JIT can
+    std::optional<Object> callNative(Function& function, const std::vector<Object>& arguments) {
+        return jit_.call(function, arguments, depthLeft());
+    }
+
+    const Jit& jit() const {
+        return jit_;
+    }
+
+    // Starts tiering hot functions and loops up to code from the given
+    // compilers. Off by default, so everything stays in the tree-walker.
+    void enableTiering(Tiering::FunctionCompiler compileFunction, Tiering::LoopCompiler compileLoop) {
+        tiering_ = std::make_unique<Tiering>(std::move(compileFunction), std::move(compileLoop));
+    }
+
+    const Tiering* tiering() const {
+        return tiering_.get();
+    }
+
+    // Where the compiled body of a hot function will appear, if tiering
+    const Tiering::Slot<BlockCode>* tierUp(const FunctionStatement& function) {
+        return tiering_ ? &tiering_->compile(function) : nullptr;
+    }
+
+    // Drops what programs defined as globals, once they are done with them.
+    // The next interpreter defines the natives again.
+    static void clearGlobals() {
+        globals_.clear();
+    }
+
+    // Called before the program run so far goes away
+    void cancelCompiles() {
+        if (tiering_) {
+            tiering_->cancel();
+        }
+    }
+
+    template <typename T> requires std::is_same_v<T, FunctionStatement> || std::is_same_v<T, ClassStatement>
+    void resolve(const T& stmt, std::vector<Capture> captures) {
+        captures_[&stmt] = std::move(captures);
+    }
+
+    // What a function or class captures, as resolved
+    const std::vector<Capture>& captures(const void* declaration) const {
+        static const std::vector<Capture> none;
+        auto it = captures_.find(declaration);
+        return it != captures_.end() ? it->second : none;
+    }
+
+    // Functions and closures of the declaration start out as hot as the
+    // profile says it got last time
+    void warmUp(const FunctionStatement& function, FunctionProfile profile) {
+        warm_[&function] = profile;
+    }
+
+    // Compiles the loop's trace for a recorded path up front, or with no
+    // path leaves it to the interpreter for good
+    void warmUp(const WhileStatement& loop, const Jit::Path* path) {
+        if (path) {
+            jit_.compileTrace(loop, *path, *this);
+        } else {
+            jit_.rejectTrace(loop);
+        }
+    }
+
+    // Set by the PurityAnalysis for every function it sees. A REPL line may
+    // reuse the address of an earlier one's function, whose results go.
+    void resolvePure(const FunctionStatement& function, bool pure) {
+        if (pure) {
+            pure_.insert(&function);
+        } else {
+            pure_.erase(&function);
+        }
+        memos_.erase(&function);
+    }
+
+    bool isPure(const FunctionStatement& function) const {
+        return pure_.contains(&function);
+    }
+
+    // Set by the TypeInference for every operator site it analyzes. Proven
+    // nodes are specialized to Proven as well, but the interpreter keeps
+    // rewriting other nodes' specializations while the compiler runs, so the
+    // compiler looks them up here.
+    void resolveProven(const void* expr, bool proven) {
+        if (proven) {
+            proven_.insert(expr);
+        } else {
+            proven_.erase(expr);
+        }
+    }
+
+    bool isProven(const void* expr) const {
+        return proven_.contains(expr);
+    }
+
+    // Set by the Resolver for every class, see Constructor
+    void resolveConstructor(const ClassStatement& stmt) {
+        auto constructor = Constructor::of(stmt);
+        constructors_[&stmt] = constructor.has_value() ? std::make_shared<const Constructor>(std::move(*constructor)) : nullptr;
+    }
+
+    std::shared_ptr<const Constructor> constructor(const ClassStatement& stmt) const {
+        auto it = constructors_.find(&stmt);
+        return it != constructors_.end() ? it->second : nullptr;
+    }
+
+    // Caches the results of calls to pure functions, up to `capacity` per
+    // declaration. Off by default. Memoized functions are left to the
+    // interpreter, as native code would call past the cache.
+    void enableMemoization(size_t capacity) {
+        memoCapacity_ = capacity;
+    }
+
+    // Objects whose last reference goes away are destroyed `slice` at a time
+    // between statements, instead of all at once wherever that happens. Off
+    // by default.
+    void deferReleases(size_t slice) {
+        if (!releaseSlice_) {
+            ReleaseQueue::instance().defer();
+        }
+        releaseSlice_ = slice;
+    }
+
+    // Between two statements of the top level or two iterations of a loop,
+    // where deferred releases get their slice
+    void safePoint() {
+        if (releaseSlice_) {
+            ReleaseQueue::instance().drain(releaseSlice_);
+        }
+    }
+
+    Memo::Stats memoStats() const {
+        Memo::Stats stats;
+        for (const auto& [declaration, memo] : memos_) {
+            stats += memo->stats();
+        }
+        return stats;
+    }
+
+    FunctionPtr makeFunction(EnvironmentPtr closure, const FunctionStatement& declaration, bool isInit, FrameKind frame, const BlockCode* code = nullptr);
+
+    // Where the 'this' a super method is bound to lives
+    void resolveThis(const SuperExpr& expr, size_t depth) {
+        locals_[&expr.method] = depth;
+    }
+
 private:
     Diagnostic& diagnostic_;
     std::ostream& out_;
     static Environment globals_;
-    EnvironmentPtr env_ = std::make_shared<Environment>(EnvironmentPtr(&globals_, [](Environment*) {}));
+    // Made once the globals are pinned
+    EnvironmentPtr env_;
     std::unordered_map<const void*, size_t> locals_;
+    // Filled by a return statement until the call it leaves takes it
+    Object return_;
+
+    std::unordered_map<const BlockStatement*, BlockScope> blocks_;
+    std::unordered_map<const FunctionStatement*, FrameKind> frameKinds_;
+    FrameStack frames_;
+    // Calls in progress
+    size_t depth_ = 0;
+    size_t maxDepth_ = SIZE_MAX;
+    // Lowest address the native stack may reach, see limitStack()
+    uintptr_t stackLimit_ = 0;
+    int callLine_ = 0;
+    std::unordered_map<const void*, std::vector<Capture>> captures_;
+    std::unordered_map<const FunctionStatement*, FunctionProfile> warm_;
+    std::unordered_set<const FunctionStatement*> pure_;
+    std::unordered_set<const void*> proven_;
+    std::optional<size_t> memoCapacity_;
+    std::unordered_map<const FunctionStatement*, std::shared_ptr<Memo>> memos_;
+    std::unordered_map<const ClassStatement*, std::shared_ptr<const Constructor>> constructors_;
+    // Objects destroyed per safe point, if releases are deferred
+    size_t releaseSlice_ = 0;
+    Jit jit_{ globals_ };
+    // Set while an iteration of a hot loop is recorded
+    Jit::Path* path_ = nullptr;
+    // Last, so that its compiles stop before the tables they read go away
+    std::unique_ptr<Tiering> tiering_;
+
+    friend class Compiler;
+    friend aot::Runtime;
 };
 
 } // cpplox
@@ -0,0 +1,75 @@
+#include <env/memo.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <variant>
+
+#include <env/number.h>
+
+namespace cpplox {
+
+// NaN equals no key, and -0 equals 0 while a function can tell them apart
+bool Memo::cacheable(const std::vector<Object>& arguments) {
+    for (const Object& argument : arguments) {
+        if (auto* number = std::get_if<double>(&argument); number && (std::isnan(*number) || (std::signbit(*number) && *number == 0))) {
+            return false;
+        }
+        bool value = std::holds_alternative<std::nullptr_t>(argument) || std::holds_alternative<bool>(argument)
+            || isNumber(argument) || std::holds_alternative<std::string>(argument);
+        if (!value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const Object* Memo::find(const std::vector<Object>& arguments) {
+    auto it = index_.find(&arguments);
+    if (it == index_.end()) {
+        stats_.misses++;
+        return nullptr;
+    }
+    stats_.hits++;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &it->second->second;
+}
+
+void Memo::insert(std::vector<Object> arguments, Object result) {
+    // A recursive call with the same arguments may have got there first
+    if (auto it = index_.find(&arguments); it != index_.end()) {
+        it->second->second = std::move(result);
+        return;
+    }
+    if (capacity_ == 0) {
+        return;
+    }
+    if (entries_.size() == capacity_) {
+        index_.erase(&entries_.back().first);
+        entries_.pop_back();
+        stats_.evictions++;
+    }
+    entries_.emplace_front(std::move(arguments), std::move(result));
+    index_.emplace(&entries_.front().first, entries_.begin());
+}
+
+// Combined as boost::hash_combine does
+size_t Memo::Hash::operator()(const std::vector<Object>* arguments) const {
+    size_t hash = arguments->size();
+    for (const Object& argument : *arguments) {
+        size_t value = isNumber(argument) ? std::hash<double>{}(toDouble(argument)) : std::hash<Object>{}(argument);
+        hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash;
+}
+
+bool Memo::Equal::operator()(const std::vector<Object>* a, const std::vector<Object>* b) const {
+    return std::ranges::equal(*a, *b, [](const Object& x, const Object& y) {
+        if (isNumber(x) && isNumber(y)) {
+            return toDouble(x) == toDouble(y);
+        }
+        return x == y;
+    });
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include <env/fwd.h>
+
+namespace cpplox {
+
+// Results of calls to one pure function, keyed by the values of their
+// arguments. Holds the `capacity` most recently used ones.
+class Memo {
+public:
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+
+        Stats& operator+=(const Stats& other) {
+            hits += other.hits;
+            misses += other.misses;
+            evictions += other.evictions;
+            return *this;
+        }
+    };
+
+    static constexpr size_t defaultCapacity = 4096;
+
+    explicit Memo(size_t capacity) : capacity_(capacity) {}
+
+    // Whether calls with these arguments can be cached: nil, booleans,
+    // numbers and strings, which compare by value
+    static bool cacheable(const std::vector<Object>& arguments);
+
+    // The result of an earlier call with these arguments, if it is still
+    // held. Valid until the next insert().
+    const Object* find(const std::vector<Object>& arguments);
+    void insert(std::vector<Object> arguments, Object result);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+    // Visits the objects held results refer to; arguments never refer to any
+    void traverse(const RefCounted::Visitor& visit) const {
+        for (const auto& [arguments, result] : entries_) {
+            visitRef(result, visit);
+        }
+    }
+
+private:
+    using Entry = std::pair<std::vector<Object>, Object>;
+
+    // An integer is the same key as the double it stands in for
+    struct Hash {
+        size_t operator()(const std::vector<Object>* arguments) const;
+    };
+
+    struct Equal {
+        bool operator()(const std::vector<Object>* a, const std::vector<Object>* b) const;
+    };
+
+    size_t capacity_;
+    // Most recently used first
+    std::list<Entry> entries_;
+    std::unordered_map<const std::vector<Object>*, std::list<Entry>::iterator, Hash, Equal> index_;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <variant>
+
+#include <env/fwd.h>
+
+namespace cpplox {
+
+// Lox numbers are doubles. A whole number that a double holds exactly, up to
+// 2^53 either way, may be held as an int64_t instead, and arithmetic on two
+// such integers stays on integers for as long as the result is one too. A
+// fraction, a result past 2^53 or -0 is computed on doubles. Either way the
+// value is the one doubles would give, so a program can't tell the two
+// apart: they compare equal, print the same and make the same memo key.
+constexpr int64_t maxInteger = int64_t{ 1 } << 53;
+
+inline bool inIntegerRange(int64_t value) {
+    return value >= -maxInteger && value <= maxInteger;
+}
+
+// `value` as an integer, if it can be held as one
+inline std::optional<int64_t> toInteger(double value) {
+    if (!(value >= -maxInteger && value <= maxInteger)) {
+        return std::nullopt;
+    }
+    auto integer = static_cast<int64_t>(value);
+    if (integer != value || (integer == 0 && std::signbit(value))) {
+        return std::nullopt;
+    }
+    return integer;
+}
+
+// A number literal, held as an integer if it can be
+inline Object number(double value) {
+    if (auto integer = toInteger(value)) {
+        return *integer;
+    }
+    return value;
+}
+
+inline bool isNumber(const Object& object) {
+    return std::holds_alternative<double>(object) || std::holds_alternative<int64_t>(object);
+}
+
+// The value of a number
+inline double toDouble(const Object& object) {
+    if (auto* integer = std::get_if<int64_t>(&object)) {
+        return static_cast<double>(*integer);
+    }
+    return *std::get_if<double>(&object);
+}
+
+// Integer arithmetic, empty when the result can't be held as an integer.
+// Operands are within 2^53, so nothing here overflows an int64_t.
+inline std::optional<int64_t> addIntegers(int64_t left, int64_t right) {
+    int64_t sum = left + right;
+    return inIntegerRange(sum) ? std::optional(sum) : std::nullopt;
+}
+
+// 0 * -1 is -0
+inline std::optional<int64_t> multiplyIntegers(int64_t left, int64_t right) {
+    int64_t product = 0;
+    if (__builtin_mul_overflow(left, right, &product) || !inIntegerRange(product) || (product == 0 && (left < 0 || right < 0))) {
+        return std::nullopt;
+    }
+    return product;
+}
+
+// 0 / -1 is -0
+inline std::optional<int64_t> divideIntegers(int64_t left, int64_t right) {
+    if (right == 0 || left % right != 0 || (left == 0 && right < 0)) {
+        return std::nullopt;
+    }
+    return left / right;
+}
+
+// -0 is a double
+inline Object negate(const Object& number) {
+    if (auto* integer = std::get_if<int64_t>(&number)) {
+        return *integer != 0 ? Object{ -*integer } : Object{ -0.0 };
+    }
+    return -*std::get_if<double>(&number);
+}
+
+// `variable = variable + step`, or `- step`, where `integer` is what the
+// variable holds
+inline void increment(Object& variable, int64_t& integer, bool add, double step) {
+    if (auto steps = toInteger(step)) {
+        if (auto sum = addIntegers(integer, add ? *steps : -*steps)) {
+            integer = *sum;
+            return;
+        }
+    }
+    variable = add ? static_cast<double>(integer) + step : static_cast<double>(integer) - step;
+}
+
+} // cpplox
\ No newline at end of file
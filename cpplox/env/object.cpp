@@ -1,5 +1,11 @@
 #include <env/object.h>
 
+#include <algorithm>
+#include <ranges>
+#include <unordered_set>
+
+#include <env/number.h>
+
 namespace cpplox {
 
 Object NativeFunction::call(Interpreter* i, std::vector<Object> arguments) {
@@ -7,9 +13,61 @@ Object NativeFunction::call(Interpreter* i, std::vector<Object> arguments) {
 }
 
 FunctionPtr Function::bind(InstancePtr instance) {
-    EnvironmentPtr env = std::make_shared<Environment>(closure_);
-    env->define("this", instance);
-    return std::make_shared<Function>(env, declaration_, isInit_);
+    auto bound = makeRef<Function>(bindThis(std::move(instance)), declaration_, isInit_, frame_, code_);
+    bound->tier_ = tier_;
+    return bound;
+}
+
+EnvironmentPtr Function::bindThis(InstancePtr instance) {
+    EnvironmentPtr env = Environment::make(closure_);
+    env->define("this", std::move(instance));
+    return env;
+}
+
+std::optional<Constructor> Constructor::of(const ClassStatement& stmt) {
+    auto method = std::ranges::find_if(stmt.methods, [](const FunctionStatement& method) {
+        return method.name.lexeme() == "init";
+    });
+    if (method == stmt.methods.end()) {
+        return std::nullopt;
+    }
+    const FunctionStatement& init = *method;
+    Constructor constructor;
+    std::unordered_set<std::string> fields;
+    for (const Statement& stmt : init.body->statements) {
+        auto* expr = std::get_if<ExprStatement>(&stmt);
+        auto* set = expr ? std::get_if<SetExpr>(&expr->expr) : nullptr;
+        if (!set || !std::holds_alternative<ThisExpr>(*set->object)) {
+            return std::nullopt;
+        }
+        Field field{ set->name.lexeme(), std::nullopt, false, nullptr };
+        if (auto* literal = std::get_if<LiteralExpr>(set->value.get())) {
+            if (auto* value = literal->object ? std::get_if<double>(&*literal->object) : nullptr) {
+                field.value = number(*value);
+            } else if (literal->object.has_value()) {
+                field.value = std::visit([](const auto& l) { return Object{ l }; }, *literal->object);
+            }
+        } else if (auto* var = std::get_if<VarExpr>(set->value.get())) {
+            auto param = std::ranges::find_if(init.params, [var](const Token& param) {
+                return param.lexeme() == var->name.lexeme();
+            });
+            if (param == init.params.end()) {
+                return std::nullopt;
+            }
+            field.param = param - init.params.begin();
+        } else {
+            return std::nullopt;
+        }
+        fields.insert(field.name);
+        constructor.fields.push_back(std::move(field));
+    }
+
+    std::unordered_set<size_t> moved;
+    for (Field& field : constructor.fields | std::views::reverse) {
+        field.last = field.param.has_value() && moved.insert(*field.param).second;
+    }
+    constructor.size = fields.size();
+    return constructor;
 }
 
 size_t Class::arity() const {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <format>
 #include <string>
 #include <variant>
@@ -7,11 +8,19 @@
 
 #include <env/env.h>
 #include <env/fwd.h>
+#include <env/memo.h>
 #include <ast/statement.h>
+#include <util/scope_guard.h>
+#include <util/slab.h>
 #include <util/traits.h>
 
 namespace cpplox {
 
+// Calls after which a function is promoted to compiled code, with tiering on
+constexpr size_t tierThreshold = 10;
+// Calls after which a function is handed to the JIT
+constexpr size_t jitThreshold = 50;
+
 template <typename T, typename = void>
 constexpr bool is_callable_v = false;
 template <typename T>
@@ -20,38 +29,123 @@ constexpr bool is_callable_v<T, std::void_t<decltype(std::declval<T>()->call(
     std::declval<std::vector<Object>>()
 ))>> = true;
 
-class Function {
+class Function : public RefCounted {
 public:
-    Function(EnvironmentPtr closure, const FunctionStatement& declaration, bool isInit) : closure_(std::move(closure)), declaration_(declaration), isInit_(isInit) {}
+    Function(EnvironmentPtr closure, const FunctionStatement& declaration, bool isInit, FrameKind frame = FrameKind::Heap, const BlockCode* code = nullptr) : closure_(std::move(closure)), declaration_(declaration), isInit_(isInit), frame_(frame), code_(code) {}
     size_t arity() const { return declaration_.params.size(); }
     template <typename T> requires std::is_same_v<T, Interpreter>
     Object call(T* i, std::vector<Object> arguments) {
-        EnvironmentPtr env = std::make_shared<Environment>(closure_);
+        if (memo_ && Memo::cacheable(arguments)) {
+            if (const Object* result = memo_->find(arguments)) {
+                return *result;
+            }
+            std::vector<Object> key = arguments;
+            Object result = run(i, std::move(arguments));
+            memo_->insert(std::move(key), result);
+            return result;
+        }
+        return run(i, std::move(arguments));
+    }
+    // Calls the method with 'this' bound to `instance`, as bind() followed by
+    // call() would.
+    template <typename T> requires std::is_same_v<T, Interpreter>
+    Object invoke(T* i, InstancePtr instance, std::vector<Object> arguments) {
+        count(i);
+        return call(i, bindThis(std::move(instance)), std::move(arguments));
+    }
+    FunctionPtr bind(InstancePtr instance);
+
+private:
+    template <typename T>
+    Object run(T* i, std::vector<Object> arguments) {
+        count(i);
+        if (jittable_ && calls_ > jitThreshold) {
+            if (auto ret = i->callNative(*this, arguments)) {
+                return *std::move(ret);
+            }
+        }
+        return call(i, closure_, std::move(arguments));
+    }
+
+    template <typename T>
+    void count(T* i) {
+        if (++calls_ == tierThreshold && !code_) {
+            tier_ = i->tierUp(declaration_);
+        }
+    }
+
+    template <typename T>
+    Object call(T* i, const EnvironmentPtr& closure, std::vector<Object> arguments) {
+        if (tier_ && !code_) {
+            code_ = tier_->load(std::memory_order_acquire);
+        }
+        EnvironmentPtr env = i->pushFrame(frame_, closure, declaration_.name.line());
+        ScopeGuard guard{ [i, frame = frame_]() {
+            i->popFrame(frame);
+        } };
         for (size_t i = 0; i < arity(); i++) {
             env->define(declaration_.params[i].lexeme(), std::move(arguments[i]));
         }
-        auto ret = i->operator()(*declaration_.body, env);
+        if (code_) {
+            auto ret = (*code_)(*i, std::move(env));
+            if (isInit_) {
+                return closure->getAt(0, "this");
+            }
+            return ret.has_value() ? *std::move(ret) : nullptr;
+        }
+        Completion completion = i->operator()(*declaration_.body, std::move(env));
         if (isInit_) {
-            return closure_->getAt(0, "this");
+            return closure->getAt(0, "this");
         }
-        if (ret.has_value()) {
-            return ret.value();
+        return completion == Completion::Return ? i->takeReturn() : nullptr;
+    }
+    EnvironmentPtr bindThis(InstancePtr instance);
+
+    void traverse(const Visitor& visit) override {
+        if (closure_) {
+            visit(*closure_);
         }
-        return nullptr;
     }
-    FunctionPtr bind(InstancePtr instance);
 
-private:
+    // The memo is shared with the declaration's other functions, so its
+    // results only count as kept alive
+    void reach(const Visitor& visit) override {
+        traverse(visit);
+        if (memo_) {
+            memo_->traverse(visit);
+        }
+    }
+
+    void detach() override {
+        closure_ = nullptr;
+        memo_.reset();
+    }
+
     EnvironmentPtr closure_;
     const FunctionStatement& declaration_;
     bool isInit_;
+    FrameKind frame_;
+    // Compiled body, if the function was created by compiled code or was
+    // promoted to it
+    const BlockCode* code_;
+    // Where the promoted body will appear
+    const std::atomic<const BlockCode*>* tier_ = nullptr;
+    // Until the JIT turns it down
+    bool jittable_ = true;
+    size_t calls_ = 0;
+    const class MachineCode* machineCode_ = nullptr;
+    // Set if the function is pure and memoization is on. Shared by every
+    // function of the declaration.
+    std::shared_ptr<Memo> memo_;
 
     friend std::formatter<Function>;
     friend Interpreter;
     friend Class;
+    friend class Jit;
+    friend aot::Runtime;
 };
 
-class NativeFunction {
+class NativeFunction : public RefCounted {
 public:
     NativeFunction(std::string name, size_t arity, std::function<Object(Interpreter*, std::vector<Object>)> call) : name_(std::move(name)), arity_(arity), call_(std::move(call)) {}
     Object call(Interpreter* i, std::vector<Object> arguments);
@@ -64,19 +158,35 @@ private:
     friend std::formatter<NativeFunction>;
 };
 
-class Class : public std::enable_shared_from_this<Class> {
+// What an init() that only sets fields does, each to a literal or to one of
+// its parameters. Class::call() fills the instance in directly instead of
+// binding and calling init().
+struct Constructor {
+    struct Field {
+        std::string name;
+        // The parameter the field is set to, if not `value`
+        std::optional<size_t> param;
+        // Whether this is the last field set to the parameter, which can
+        // then be moved
+        bool last = false;
+        Object value;
+    };
+    std::vector<Field> fields;
+    // Fields set, each counted once
+    size_t size = 0;
+
+    // The constructor of a class that declares such an init()
+    static std::optional<Constructor> of(const ClassStatement& stmt);
+};
+
+class Class : public RefCounted {
 public:
-    Class(std::string name, std::unordered_map<std::string, FunctionPtr> methods, ClassPtr superclass = nullptr) : name_(std::move(name)), methods_(std::move(methods)), superclass_(std::move(superclass)) {}
+    // Without a constructor of its own, a class that doesn't declare init()
+    // uses its superclass's
+    Class(std::string name, std::unordered_map<std::string, FunctionPtr> methods, ClassPtr superclass = nullptr, std::shared_ptr<const Constructor> constructor = nullptr);
 
     template <typename T> requires std::is_same_v<T, Interpreter>
-    Object call(T* i, std::vector<Object> arguments) {
-        auto instance = std::make_shared<Instance>(shared_from_this());
-        auto init = findMethod("init");
-        if (init) {
-            init->bind(instance)->call(i, std::move(arguments));
-        }
-        return instance;
-    }
+    Object call(T* i, std::vector<Object> arguments);
     size_t arity() const;
     FunctionPtr findMethod(const std::string& name) {
         if (auto it = methods_.find(name); it != methods_.end()) {
@@ -91,15 +201,32 @@ public:
     }
 
 private:
+    void traverse(const Visitor& visit) override {
+        for (const auto& [name, method] : methods_) {
+            visit(*method);
+        }
+        if (superclass_) {
+            visit(*superclass_);
+        }
+    }
+
+    void detach() override {
+        methods_.clear();
+        superclass_ = nullptr;
+    }
+
     std::string name_;
     std::unordered_map<std::string, FunctionPtr> methods_;
     ClassPtr superclass_;
+    std::shared_ptr<const Constructor> constructor_;
+    // Where its instances live, next to each other
+    Slab slab_;
     friend Instance;
     friend Interpreter;
     friend std::formatter<Class>;
 };
 
-class Instance : public std::enable_shared_from_this<Instance> {
+class Instance : public RefCounted {
 public:
     Instance(ClassPtr c) : class_(std::move(c)) {}
 
@@ -110,7 +237,7 @@ public:
 
         auto func = class_->findMethod(name.lexeme());
         if (func) {
-            return func->bind(shared_from_this());
+            return func->bind(InstancePtr(this));
         }
 
         return std::nullopt;
@@ -121,12 +248,65 @@ public:
     }
 
 private:
+    // Gives the slot back to the class's slab
+    void destroy() override;
+
+    void traverse(const Visitor& visit) override {
+        visit(*class_);
+        for (const auto& [name, field] : fields_) {
+            visitRef(field, visit);
+        }
+    }
+
+    // Keeps the class, whose slab the instance lives in
+    void detach() override {
+        fields_.clear();
+    }
+
     ClassPtr class_;
     std::unordered_map<std::string, Object> fields_;
+    friend Class;
     friend Interpreter;
+    friend class Compiler;
+    friend aot::Runtime;
     friend std::formatter<Instance>;
 };
 
+inline Class::Class(std::string name, std::unordered_map<std::string, FunctionPtr> methods, ClassPtr superclass, std::shared_ptr<const Constructor> constructor)
+    : name_(std::move(name)), methods_(std::move(methods)), superclass_(std::move(superclass)),
+      constructor_(methods_.contains("init") || !superclass_ ? std::move(constructor) : superclass_->constructor_),
+      slab_(sizeof(Instance), alignof(Instance)) {}
+
+template <typename T> requires std::is_same_v<T, Interpreter>
+Object Class::call(T* i, std::vector<Object> arguments) {
+    InstancePtr instance(new (slab_.allocate()) Instance(ClassPtr(this)));
+    if (constructor_) {
+        instance->fields_.reserve(constructor_->size);
+        for (const Constructor::Field& field : constructor_->fields) {
+            if (!field.param) {
+                instance->fields_[field.name] = field.value;
+            } else if (field.last) {
+                instance->fields_[field.name] = std::move(arguments[*field.param]);
+            } else {
+                instance->fields_[field.name] = arguments[*field.param];
+            }
+        }
+        return instance;
+    }
+    auto init = findMethod("init");
+    if (init) {
+        init->invoke(i, instance, std::move(arguments));
+    }
+    return instance;
+}
+
+inline void Instance::destroy() {
+    // Holds on to the class, and so the slab, until the slot is back in it
+    ClassPtr instanceClass = std::move(class_);
+    this->~Instance();
+    instanceClass->slab_.deallocate(this);
+}
+
 } // cpplox
 
 template <>
@@ -140,6 +320,9 @@ struct std::formatter<cpplox::Object> : std::formatter<std::string> {
                 return v ? "true" : "false";
             } else if constexpr (std::is_same_v<T, double>) {
                 return std::format("{}", v);
+            } else if constexpr (std::is_same_v<T, int64_t>) {
+                // As the double it stands in for, 1e+16 and all
+                return std::format("{}", static_cast<double>(v));
             } else if constexpr (std::is_same_v<T, std::string>) {
                 return std::format("\"{}\"", v);
             } else if constexpr (cpplox::is_derefable_v<T>) {
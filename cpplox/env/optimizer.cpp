@@ -0,0 +1,248 @@
+#include <variant>
+
+#include <env/optimizer.h>
+
+namespace {
+
+bool isComparison(cpplox::TokenType op) {
+    return op == cpplox::TokenType::GREATER || op == cpplox::TokenType::GREATER_EQUAL
+        || op == cpplox::TokenType::LESS || op == cpplox::TokenType::LESS_EQUAL;
+}
+
+}
+
+namespace cpplox {
+
+void Optimizer::operator()(AssignExpr& expr) {
+    optimize(*expr.object);
+}
+
+void Optimizer::operator()(BinaryExpr& expr) {
+    optimize(*expr.left);
+    optimize(*expr.right);
+}
+
+void Optimizer::operator()(CallExpr& expr) {
+    optimize(*expr.callee);
+    for (auto& argument : expr.arguments) {
+        optimize(argument);
+    }
+}
+
+void Optimizer::operator()(GetExpr& expr) {
+    optimize(*expr.object);
+}
+
+void Optimizer::operator()(GroupingExpr& expr) {
+    optimize(*expr.expr);
+}
+
+void Optimizer::operator()(LiteralExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(LogicalExpr& expr) {
+    optimize(*expr.left);
+    optimize(*expr.right);
+}
+
+void Optimizer::operator()(SetExpr& expr) {
+    optimize(*expr.object);
+    optimize(*expr.value);
+}
+
+void Optimizer::operator()(SuperExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(ThisExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(UnaryExpr& expr) {
+    optimize(*expr.right);
+}
+
+void Optimizer::operator()(VarExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(LocalCompareExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(LocalIncrementExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(ThisGetExpr&) {
+    // no-op
+}
+
+void Optimizer::operator()(InvokeExpr& expr) {
+    optimize(*expr.object);
+    for (auto& argument : expr.arguments) {
+        optimize(argument);
+    }
+}
+
+void Optimizer::operator()(BlockStatement& stmt) {
+    optimize(stmt.statements);
+}
+
+void Optimizer::operator()(ClassStatement& stmt) {
+    for (auto& method : stmt.methods) {
+        operator()(method);
+    }
+}
+
+void Optimizer::operator()(ExprStatement& stmt) {
+    optimize(stmt.expr);
+}
+
+void Optimizer::operator()(FunctionStatement& stmt) {
+    operator()(*stmt.body);
+}
+
+void Optimizer::operator()(IfStatement& stmt) {
+    optimize(stmt.condition);
+    optimize(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        optimize(*stmt.elseBranch);
+    }
+}
+
+void Optimizer::operator()(PrintStatement& stmt) {
+    optimize(stmt.expr);
+}
+
+void Optimizer::operator()(ReturnStatement& stmt) {
+    if (stmt.value.has_value()) {
+        optimize(*stmt.value);
+    }
+}
+
+void Optimizer::operator()(VarStatement& stmt) {
+    if (stmt.initializer.has_value()) {
+        optimize(*stmt.initializer);
+    }
+}
+
+void Optimizer::operator()(WhileStatement& stmt) {
+    optimize(stmt.condition);
+    operator()(*stmt.body);
+}
+
+void Optimizer::optimize(std::vector<Statement>& stmts) {
+    for (auto& stmt : stmts) {
+        optimize(stmt);
+    }
+}
+
+void Optimizer::optimize(Statement& stmt) {
+    std::visit(*this, stmt);
+}
+
+// Patterns are matched top-down, so that `this.m()` becomes an invocation
+// rather than a call of a fused `this.m`.
+void Optimizer::optimize(Expr& expr) {
+    fuseLocalCompare(expr) || fuseLocalIncrement(expr) || fuseThisGet(expr) || fuseInvoke(expr);
+    std::visit(*this, expr);
+}
+
+// `a < b`, `a <= b`, `a > b`, `a >= b`
+bool Optimizer::fuseLocalCompare(Expr& expr) {
+    auto* binary = std::get_if<BinaryExpr>(&expr);
+    if (!binary || !isComparison(binary->op.type())) {
+        return false;
+    }
+    auto* left = std::get_if<VarExpr>(binary->left.get());
+    auto* right = std::get_if<VarExpr>(binary->right.get());
+    if (!left || !right) {
+        return false;
+    }
+    auto leftDepth = interpreter_.resolvedDepth(left);
+    auto rightDepth = interpreter_.resolvedDepth(right);
+    if (!leftDepth || !rightDepth) {
+        return false;
+    }
+
+    LocalCompareExpr fused(left->name.lexeme(), *leftDepth, binary->op.type(), right->name.lexeme(), *rightDepth, binary->op.line());
+    interpreter_.forget(left);
+    interpreter_.forget(right);
+    expr = std::move(fused);
+    stats_.localCompares++;
+    return true;
+}
+
+// `a = a + 1`, `a = a - 1`
+bool Optimizer::fuseLocalIncrement(Expr& expr) {
+    auto* assign = std::get_if<AssignExpr>(&expr);
+    if (!assign) {
+        return false;
+    }
+    auto* binary = std::get_if<BinaryExpr>(assign->object.get());
+    if (!binary || (binary->op.type() != TokenType::PLUS && binary->op.type() != TokenType::MINUS)) {
+        return false;
+    }
+    auto* var = std::get_if<VarExpr>(binary->left.get());
+    auto* literal = std::get_if<LiteralExpr>(binary->right.get());
+    if (!var || !literal || var->name.lexeme() != assign->name.lexeme()
+        || !literal->object.has_value() || !std::holds_alternative<double>(*literal->object)) {
+        return false;
+    }
+    auto depth = interpreter_.resolvedDepth(assign);
+    if (!depth || interpreter_.resolvedDepth(var) != depth) {
+        return false;
+    }
+
+    LocalIncrementExpr fused(assign->name.lexeme(), *depth, binary->op.type(), std::get<double>(*literal->object), binary->op.line());
+    interpreter_.forget(assign);
+    interpreter_.forget(var);
+    expr = std::move(fused);
+    stats_.localIncrements++;
+    return true;
+}
+
+// `this.name`
+bool Optimizer::fuseThisGet(Expr& expr) {
+    auto* get = std::get_if<GetExpr>(&expr);
+    if (!get) {
+        return false;
+    }
+    auto* self = std::get_if<ThisExpr>(get->object.get());
+    if (!self) {
+        return false;
+    }
+    auto depth = interpreter_.resolvedDepth(self);
+    if (!depth) {
+        return false;
+    }
+
+    ThisGetExpr fused(*depth, get->name.lexeme(), get->name.line());
+    interpreter_.forget(self);
+    expr = std::move(fused);
+    stats_.thisGets++;
+    return true;
+}
+
+// `object.name(arguments)`
+bool Optimizer::fuseInvoke(Expr& expr) {
+    auto* call = std::get_if<CallExpr>(&expr);
+    if (!call) {
+        return false;
+    }
+    auto* get = std::get_if<GetExpr>(call->callee.get());
+    if (!get) {
+        return false;
+    }
+
+    // The object and arguments keep their addresses, and with them their
+    // resolved distances.
+    InvokeExpr fused(std::move(get->object), get->name, call->paren, std::move(call->arguments));
+    expr = std::move(fused);
+    stats_.invokes++;
+    return true;
+}
+
+} // cpplox
\ No newline at end of file
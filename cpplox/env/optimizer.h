@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Rewrites resolved programs, fusing the hottest node shapes into
+// superinstructions that the interpreter evaluates with a single handler.
+// Runs after the Resolver, whose scope distances it moves into the fused
+// nodes.
+class Optimizer {
+public:
+    // Number of sites fused per pattern
+    struct Stats {
+        size_t localCompares = 0;
+        size_t localIncrements = 0;
+        size_t thisGets = 0;
+        size_t invokes = 0;
+
+        Stats& operator+=(const Stats& other) {
+            localCompares += other.localCompares;
+            localIncrements += other.localIncrements;
+            thisGets += other.thisGets;
+            invokes += other.invokes;
+            return *this;
+        }
+
+        size_t total() const {
+            return localCompares + localIncrements + thisGets + invokes;
+        }
+    };
+
+    Optimizer(Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    void operator()(AssignExpr& expr);
+    void operator()(BinaryExpr& expr);
+    void operator()(CallExpr& expr);
+    void operator()(GetExpr& expr);
+    void operator()(GroupingExpr& expr);
+    void operator()(LiteralExpr& expr);
+    void operator()(LogicalExpr& expr);
+    void operator()(SetExpr& expr);
+    void operator()(SuperExpr& expr);
+    void operator()(ThisExpr& expr);
+    void operator()(UnaryExpr& expr);
+    void operator()(VarExpr& expr);
+    void operator()(LocalCompareExpr& expr);
+    void operator()(LocalIncrementExpr& expr);
+    void operator()(ThisGetExpr& expr);
+    void operator()(InvokeExpr& expr);
+
+    void operator()(BlockStatement& stmt);
+    void operator()(ClassStatement& stmt);
+    void operator()(ExprStatement& stmt);
+    void operator()(FunctionStatement& stmt);
+    void operator()(IfStatement& stmt);
+    void operator()(PrintStatement& stmt);
+    void operator()(ReturnStatement& stmt);
+    void operator()(VarStatement& stmt);
+    void operator()(WhileStatement& stmt);
+
+    void optimize(std::vector<Statement>& stmts);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    void optimize(Expr& expr);
+    void optimize(Statement& stmt);
+
+    bool fuseLocalCompare(Expr& expr);
+    bool fuseLocalIncrement(Expr& expr);
+    bool fuseThisGet(Expr& expr);
+    bool fuseInvoke(Expr& expr);
+
+    Stats stats_;
+    Interpreter& interpreter_;
+};
+
+} // cpplox
\ No newline at end of file
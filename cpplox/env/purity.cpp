@@ -0,0 +1,237 @@
+#include <env/purity.h>
+
+#include <type_traits>
+#include <variant>
+
+#include <ast/walk.h>
+
+namespace cpplox {
+
+void PurityAnalysis::operator()(const AssignExpr& expr) {
+    check(*expr.object);
+    pure_ = pure_ && isLocal(expr.name.lexeme());
+}
+
+void PurityAnalysis::operator()(const BinaryExpr& expr) {
+    check(*expr.left);
+    check(*expr.right);
+}
+
+void PurityAnalysis::operator()(const CallExpr& expr) {
+    check(*expr.callee);
+    for (const Expr& argument : expr.arguments) {
+        check(argument);
+    }
+}
+
+// Fields can change between calls
+void PurityAnalysis::operator()(const GetExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const GroupingExpr& expr) {
+    check(*expr.expr);
+}
+
+void PurityAnalysis::operator()(const LiteralExpr&) {
+    // no-op
+}
+
+void PurityAnalysis::operator()(const LogicalExpr& expr) {
+    check(*expr.left);
+    check(*expr.right);
+}
+
+void PurityAnalysis::operator()(const SetExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const SuperExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const ThisExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const UnaryExpr& expr) {
+    check(*expr.right);
+}
+
+void PurityAnalysis::operator()(const VarExpr& expr) {
+    if (!isLocal(expr.name.lexeme())) {
+        refer(expr.name.lexeme());
+    }
+}
+
+// Fused from variables the resolver found in some scope, which may be an
+// enclosing function's
+void PurityAnalysis::operator()(const LocalCompareExpr& expr) {
+    pure_ = pure_ && isLocal(expr.left) && isLocal(expr.right);
+}
+
+void PurityAnalysis::operator()(const LocalIncrementExpr& expr) {
+    pure_ = pure_ && isLocal(expr.name);
+}
+
+void PurityAnalysis::operator()(const ThisGetExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const InvokeExpr&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const BlockStatement& stmt) {
+    scopes_.emplace_back();
+    for (const Statement& s : stmt.statements) {
+        check(s);
+    }
+    scopes_.pop_back();
+}
+
+void PurityAnalysis::operator()(const ClassStatement&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const ExprStatement& stmt) {
+    check(stmt.expr);
+}
+
+// A new closure on every call
+void PurityAnalysis::operator()(const FunctionStatement&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const IfStatement& stmt) {
+    check(stmt.condition);
+    check(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        check(*stmt.elseBranch);
+    }
+}
+
+void PurityAnalysis::operator()(const PrintStatement&) {
+    pure_ = false;
+}
+
+void PurityAnalysis::operator()(const ReturnStatement& stmt) {
+    if (stmt.value.has_value()) {
+        check(*stmt.value);
+    }
+}
+
+void PurityAnalysis::operator()(const VarStatement& stmt) {
+    if (stmt.initializer.has_value()) {
+        check(*stmt.initializer);
+    }
+    scopes_.back().insert(stmt.name.lexeme());
+}
+
+void PurityAnalysis::operator()(const WhileStatement& stmt) {
+    check(stmt.condition);
+    operator()(*stmt.body);
+}
+
+void PurityAnalysis::analyze(const std::vector<Statement>& stmts) {
+    std::unordered_map<std::string, size_t> declarations;
+    std::unordered_set<std::string> assigned;
+    std::unordered_set<const FunctionStatement*> methods;
+    std::vector<const FunctionStatement*> functions;
+    walk(stmts, [&](size_t, const auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, ClassStatement>) {
+            declarations[node.name.lexeme()]++;
+            for (const FunctionStatement& method : node.methods) {
+                methods.insert(&method);
+            }
+        } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+            for (const Token& param : node.params) {
+                declarations[param.lexeme()]++;
+            }
+            if (!methods.contains(&node)) {
+                declarations[node.name.lexeme()]++;
+                functions.push_back(&node);
+            }
+        } else if constexpr (std::is_same_v<T, VarStatement>) {
+            declarations[node.name.lexeme()]++;
+        } else if constexpr (std::is_same_v<T, AssignExpr>) {
+            assigned.insert(node.name.lexeme());
+        } else if constexpr (std::is_same_v<T, LocalIncrementExpr>) {
+            assigned.insert(node.name);
+        }
+    });
+    functions_.clear();
+    for (const FunctionStatement* function : functions) {
+        const std::string& name = function->name.lexeme();
+        if (declarations[name] == 1 && !assigned.contains(name)) {
+            functions_[name] = function;
+        }
+    }
+
+    // Every function that only computes starts out pure. Those calling one
+    // that isn't are then dropped until none is left to drop.
+    std::unordered_map<const FunctionStatement*, std::unordered_set<const FunctionStatement*>> pure;
+    for (const FunctionStatement* function : functions) {
+        if (check(*function)) {
+            pure[function] = std::move(callees_);
+        }
+    }
+    for (bool dropped = true; dropped;) {
+        dropped = std::erase_if(pure, [&pure](const auto& entry) {
+            for (const FunctionStatement* callee : entry.second) {
+                if (!pure.contains(callee)) {
+                    return true;
+                }
+            }
+            return false;
+        }) > 0;
+    }
+
+    for (const FunctionStatement* function : functions) {
+        interpreter_.resolvePure(*function, pure.contains(function));
+    }
+    for (const FunctionStatement* method : methods) {
+        interpreter_.resolvePure(*method, false);
+    }
+    stats_.functions += functions.size();
+    stats_.pure += pure.size();
+}
+
+void PurityAnalysis::check(const Expr& expr) {
+    std::visit(*this, expr);
+}
+
+void PurityAnalysis::check(const Statement& stmt) {
+    std::visit(*this, stmt);
+}
+
+bool PurityAnalysis::check(const FunctionStatement& stmt) {
+    pure_ = true;
+    callees_.clear();
+    scopes_.assign(1, {});
+    for (const Token& param : stmt.params) {
+        scopes_.back().insert(param.lexeme());
+    }
+    operator()(*stmt.body);
+    return pure_;
+}
+
+bool PurityAnalysis::isLocal(const std::string& name) const {
+    for (const auto& scope : scopes_) {
+        if (scope.contains(name)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PurityAnalysis::refer(const std::string& name) {
+    if (auto it = functions_.find(name); it != functions_.end()) {
+        callees_.insert(it->second);
+    } else {
+        pure_ = false;
+    }
+}
+
+} // cpplox
\ No newline at end of file
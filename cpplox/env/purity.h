@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Finds the functions of a resolved program whose result only depends on
+// their arguments, and marks them pure in the interpreter so that calls to
+// them can be memoized.
+//
+// A pure function only reads and writes its own locals, and calls or reads
+// functions that are themselves pure. It doesn't print, touch instances, or
+// declare functions or classes. A function is referred to by a name that the
+// program declares once and never assigns, so that the name can't come to
+// hold anything else. The only native, clock(), isn't pure.
+class PurityAnalysis {
+public:
+    struct Stats {
+        size_t functions = 0;
+        size_t pure = 0;
+
+        Stats& operator+=(const Stats& other) {
+            functions += other.functions;
+            pure += other.pure;
+            return *this;
+        }
+    };
+
+    PurityAnalysis(Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    void operator()(const AssignExpr& expr);
+    void operator()(const BinaryExpr& expr);
+    void operator()(const CallExpr& expr);
+    void operator()(const GetExpr& expr);
+    void operator()(const GroupingExpr& expr);
+    void operator()(const LiteralExpr& expr);
+    void operator()(const LogicalExpr& expr);
+    void operator()(const SetExpr& expr);
+    void operator()(const SuperExpr& expr);
+    void operator()(const ThisExpr& expr);
+    void operator()(const UnaryExpr& expr);
+    void operator()(const VarExpr& expr);
+    void operator()(const LocalCompareExpr& expr);
+    void operator()(const LocalIncrementExpr& expr);
+    void operator()(const ThisGetExpr& expr);
+    void operator()(const InvokeExpr& expr);
+
+    void operator()(const BlockStatement& stmt);
+    void operator()(const ClassStatement& stmt);
+    void operator()(const ExprStatement& stmt);
+    void operator()(const FunctionStatement& stmt);
+    void operator()(const IfStatement& stmt);
+    void operator()(const PrintStatement& stmt);
+    void operator()(const ReturnStatement& stmt);
+    void operator()(const VarStatement& stmt);
+    void operator()(const WhileStatement& stmt);
+
+    void analyze(const std::vector<Statement>& stmts);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    void check(const Expr& expr);
+    void check(const Statement& stmt);
+    // Whether the function does nothing but compute, collecting the
+    // functions it refers to in `callees_`
+    bool check(const FunctionStatement& stmt);
+    bool isLocal(const std::string& name) const;
+    void refer(const std::string& name);
+
+    Interpreter& interpreter_;
+    // Functions by the names that always hold them
+    std::unordered_map<std::string, const FunctionStatement*> functions_;
+    // Locals of the function being checked, innermost scope last
+    std::vector<std::unordered_set<std::string>> scopes_;
+    std::unordered_set<const FunctionStatement*> callees_;
+    bool pure_ = true;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
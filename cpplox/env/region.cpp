@@ -0,0 +1,86 @@
+#include <env/region.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <env/object.h>
+
+namespace cpplox {
+
+Region::Region() : previous_(enter()) {}
+
+Region::~Region() {
+    release();
+    leave(previous_);
+}
+
+void Region::hold() {
+    forEach([](RefCounted& object) {
+        setPinned(object, true);
+    });
+}
+
+void Region::release(const std::function<void()>& drop) {
+    hold();
+    std::vector<RefCounted*> objects;
+    objects.reserve(size());
+    forEach([&](RefCounted& object) {
+        objects.push_back(&object);
+    });
+    if (drop) {
+        drop();
+    }
+
+    // Counts not explained by references from inside the region come from
+    // outside
+    std::unordered_map<const RefCounted*, uint32_t> internal;
+    for (RefCounted* object : objects) {
+        traverse(*object, [&](RefCounted& to) {
+            if (contains(to)) {
+                internal[&to]++;
+            }
+        });
+    }
+    std::vector<RefCounted*> exported;
+    for (RefCounted* object : objects) {
+        if (refs(*object) > internal[object]) {
+            exported.push_back(object);
+        }
+    }
+    while (!exported.empty()) {
+        RefCounted* object = exported.back();
+        exported.pop_back();
+        if (!contains(*object)) {
+            continue;
+        }
+        remove(*object);
+        setPinned(*object, false);
+        stats_.exported++;
+        reach(*object, [&](RefCounted& to) {
+            if (contains(to)) {
+                exported.push_back(&to);
+            }
+        });
+    }
+
+    // Only the region refers to what is left
+    std::erase_if(objects, [&](RefCounted* object) {
+        return !contains(*object);
+    });
+    for (RefCounted* object : objects) {
+        detach(*object);
+    }
+    // An instance gives its slot back to its class's slab
+    std::ranges::stable_partition(objects, [](RefCounted* object) {
+        return dynamic_cast<Instance*>(object) != nullptr;
+    });
+    for (RefCounted* object : objects) {
+        remove(*object);
+        setPinned(*object, false);
+        destroy(*object);
+    }
+    stats_.freed += objects.size();
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+#include <util/ref.h>
+
+namespace cpplox {
+
+// The runtime objects of one run of a program. Every environment, function,
+// class, instance and upvalue made on the thread while the region is current
+// belongs to it, and release() frees them in one pass over the region instead
+// of one by one as their counts drop. Objects are detached from each other
+// before any is freed, so freeing one never cascades into the next, however
+// deep the graph, and cycles counting alone would leak go too.
+//
+// An object referenced from outside the region when it is released, like a
+// value the host held on to, is exported: it survives, with everything it
+// reaches, as an ordinary counted object.
+class Region : public RefList {
+public:
+    struct Stats {
+        size_t freed = 0;
+        size_t exported = 0;
+
+        Stats& operator+=(const Stats& other) {
+            freed += other.freed;
+            exported += other.exported;
+            return *this;
+        }
+    };
+
+    // Current on the thread until destroyed. Regions nest.
+    Region();
+    ~Region();
+
+    // Keeps the objects of the region from being freed until release(), so
+    // that whatever lets go of them, like the interpreter and the AST going
+    // away, doesn't free them one by one
+    void hold();
+
+    // Frees the objects of the region, except exported ones. `drop` is called
+    // first with every object held in place, to let go of references from
+    // outside the region, like the globals, without freeing anything.
+    void release(const std::function<void()>& drop = {});
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    RefList* previous_;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
@@ -1,8 +1,23 @@
+#include <algorithm>
+#include <optional>
 #include <variant>
 
 #include <env/resolver.h>
 #include <util/scope_guard.h>
 
+namespace {
+
+// Only declarations directly inside a block add names to its scope.
+bool declaresLocals(const std::vector<cpplox::Statement>& stmts) {
+    return std::ranges::any_of(stmts, [](const cpplox::Statement& stmt) {
+        return std::holds_alternative<cpplox::VarStatement>(stmt)
+            || std::holds_alternative<cpplox::FunctionStatement>(stmt)
+            || std::holds_alternative<cpplox::ClassStatement>(stmt);
+    });
+}
+
+}
+
 namespace cpplox {
 
 
@@ -52,6 +67,10 @@ void Resolver::operator()(const SuperExpr& expr) {
         interpreter_.error(expr.keyword, "Can't use 'super' in a class with no superclass.");
     }
     resolveLocal(expr, expr.keyword);
+    // The method is bound to 'this', which a closure may capture separately.
+    if (auto depth = lookUpLocal("this")) {
+        interpreter_.resolveThis(expr, *depth);
+    }
 }
 
 void Resolver::operator()(const ThisExpr& expr) {
@@ -78,7 +97,7 @@ void Resolver::operator()(const VarExpr& expr) {
 }
 
 void Resolver::operator()(const BlockStatement& stmt) {
-    resolve(stmt.statements);
+    resolveBlock(stmt);
 }
 
 void Resolver::operator()(const ClassStatement& stmt) {
@@ -95,7 +114,12 @@ void Resolver::operator()(const ClassStatement& stmt) {
         }
         currentClass_ = ClassType::SUBCLASS;
         operator()(*stmt.superclass);
+    }
 
+    // Methods share the closure of their class.
+    beginClosure();
+
+    if (stmt.superclass.has_value()) {
         beginScope();
         scopes_.back()["super"] = true;
     }
@@ -110,6 +134,9 @@ void Resolver::operator()(const ClassStatement& stmt) {
     if (stmt.superclass.has_value()) {
         endScope();
     }
+
+    endClosure(stmt);
+    interpreter_.resolveConstructor(stmt);
 }
 
 void Resolver::operator()(const ExprStatement& stmt) {
@@ -160,7 +187,7 @@ void Resolver::operator()(const VarStatement& stmt) {
 
 void Resolver::operator()(const WhileStatement& stmt) {
     resolve(stmt.condition);
-    resolve(stmt.body->statements);
+    resolveBlock(*stmt.body);
 }
 
 void Resolver::resolve(const Expr& expr) {
@@ -184,21 +211,90 @@ void Resolver::resolveFunction(const FunctionStatement& stmt, FunctionType funcT
         currentFunction_ = enclosingFunction;
     } };
 
+    // Methods are closed over by their class instead.
+    bool closure = funcType == FunctionType::FUNCTION;
+    if (closure) {
+        beginClosure();
+    }
+
     beginScope();
     for (const auto& param : stmt.params) {
         declare(param);
         define(param);
     }
-    resolve(stmt.body->statements);
+    resolveBlock(*stmt.body);
+    // Escape analysis: the call frame only outlives the call when a closure
+    // captures a parameter.
+    interpreter_.resolve(stmt, capturedScopes_.back() ? FrameKind::Heap : FrameKind::Stack);
+    endScope();
+
+    if (closure) {
+        endClosure(stmt);
+    }
+}
+
+void Resolver::resolveBlock(const BlockStatement& stmt) {
+    if (!declaresLocals(stmt.statements)) {
+        // No environment is created for the block, so references inside it
+        // must not count a scope for it either.
+        interpreter_.resolve(stmt, BlockScope::None);
+        resolve(stmt.statements, false);
+        return;
+    }
+
+    beginScope();
+    for (const auto& s : stmt.statements) {
+        resolve(s);
+    }
+    // Unless a closure captures one of its variables, nothing can refer to
+    // the block's environment once the block is left.
+    interpreter_.resolve(stmt, capturedScopes_.back() ? BlockScope::Fresh : BlockScope::Stack);
     endScope();
 }
 
+std::optional<size_t> Resolver::lookUpLocal(const std::string& name) {
+    for (int i = scopes_.size() - 1; i >= 0; i--) {
+        if (scopes_[i].contains(name)) {
+            return scopes_.size() - 1 - capture(name, i);
+        }
+    }
+    return std::nullopt;
+}
+
+// Threads a variable declared in `scope` through the closure scope of every
+// function and class between its declaration and the reference, each one
+// capturing it from the next outer one. Returns the scope the reference
+// resolves to.
+size_t Resolver::capture(const std::string& name, size_t scope) {
+    size_t from = scope;
+    for (auto& closure : closures_) {
+        if (closure.scope <= scope) {
+            continue;
+        }
+        // The closure is created in the scope just outside its own.
+        closure.captures.push_back({ name, closure.scope - 1 - from });
+        scopes_[closure.scope][name] = true;
+        from = closure.scope;
+    }
+    if (from != scope) {
+        capturedScopes_[scope] = true;
+    }
+    return from;
+}
+
+void Resolver::beginClosure() {
+    beginScope();
+    closures_.push_back({ scopes_.size() - 1, {} });
+}
+
 void Resolver::beginScope() {
     scopes_.push_back({});
+    capturedScopes_.push_back(false);
 }
 
 void Resolver::endScope() {
     scopes_.pop_back();
+    capturedScopes_.pop_back();
 }
 
 void Resolver::declare(const Token& name) {
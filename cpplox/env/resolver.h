@@ -1,5 +1,6 @@
 #pragma once
 
+#include <optional>
 #include <unordered_map>
 #include <vector>
 
@@ -41,6 +42,11 @@ public:
     void operator()(const ThisExpr& expr);
     void operator()(const UnaryExpr& expr);
     void operator()(const VarExpr& expr);
+    // Only created by the Optimizer, after resolution
+    void operator()(const LocalCompareExpr&) {}
+    void operator()(const LocalIncrementExpr&) {}
+    void operator()(const ThisGetExpr&) {}
+    void operator()(const InvokeExpr&) {}
 
     void operator()(const BlockStatement& stmt);
     void operator()(const ClassStatement& stmt);
@@ -62,20 +68,38 @@ private:
 
     template <typename T> requires is_contained_in_v<T, Expr>
     void resolveLocal(const T& expr, const Token& name) {
-        for (int i = scopes_.size() - 1; i >= 0; i--) {
-            if (scopes_[i].contains(name.lexeme())) {
-                interpreter_.resolve(expr, scopes_.size() - 1 - i);
-                return;
-            }
+        if (auto depth = lookUpLocal(name.lexeme())) {
+            interpreter_.resolve(expr, *depth);
         }
     }
 
+    std::optional<size_t> lookUpLocal(const std::string& name);
+    size_t capture(const std::string& name, size_t scope);
+
     void resolveFunction(const FunctionStatement& stmt, FunctionType funcType);
+    void resolveBlock(const BlockStatement& stmt);
+
+    void beginClosure();
+    template <typename T>
+    void endClosure(const T& stmt) {
+        interpreter_.resolve(stmt, std::move(closures_.back().captures));
+        closures_.pop_back();
+        endScope();
+    }
 
     void declare(const Token& name);
     void define(const Token& name);
 
     std::vector<std::unordered_map<std::string, bool>> scopes_;
+    // Parallel to scopes_, set once a closure captures one of its variables
+    std::vector<bool> capturedScopes_;
+    // Functions and classes being resolved, innermost last. Their closure
+    // scope holds the variables they capture from enclosing scopes.
+    struct Closure {
+        size_t scope;
+        std::vector<Capture> captures;
+    };
+    std::vector<Closure> closures_;
     FunctionType currentFunction_ = FunctionType::None;
     ClassType currentClass_ = ClassType::None;
     Interpreter& interpreter_;
@@ -0,0 +1,327 @@
+#include <env/scalar.h>
+
+#include <algorithm>
+#include <type_traits>
+#include <variant>
+
+#include <ast/walk.h>
+
+namespace cpplox {
+
+void ScalarReplacement::operator()(AssignExpr& expr) {
+    replace(*expr.object);
+}
+
+void ScalarReplacement::operator()(BinaryExpr& expr) {
+    replace(*expr.left);
+    replace(*expr.right);
+}
+
+void ScalarReplacement::operator()(CallExpr& expr) {
+    replace(*expr.callee);
+    for (auto& argument : expr.arguments) {
+        replace(argument);
+    }
+}
+
+void ScalarReplacement::operator()(GetExpr& expr) {
+    replace(*expr.object);
+}
+
+void ScalarReplacement::operator()(GroupingExpr& expr) {
+    replace(*expr.expr);
+}
+
+void ScalarReplacement::operator()(LiteralExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(LogicalExpr& expr) {
+    replace(*expr.left);
+    replace(*expr.right);
+}
+
+void ScalarReplacement::operator()(SetExpr& expr) {
+    replace(*expr.object);
+    replace(*expr.value);
+}
+
+void ScalarReplacement::operator()(SuperExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(ThisExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(UnaryExpr& expr) {
+    replace(*expr.right);
+}
+
+void ScalarReplacement::operator()(VarExpr&) {
+    // no-op
+}
+
+// Superinstructions are only fused after resolution
+void ScalarReplacement::operator()(LocalCompareExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(LocalIncrementExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(ThisGetExpr&) {
+    // no-op
+}
+
+void ScalarReplacement::operator()(InvokeExpr& expr) {
+    replace(*expr.object);
+    for (auto& argument : expr.arguments) {
+        replace(argument);
+    }
+}
+
+// `var p = C(a, b);` becomes `var p.x = a; var p.y = b;`, and so on for the
+// fields init() sets to a literal
+void ScalarReplacement::operator()(BlockStatement& stmt) {
+    std::vector<Statement> statements;
+    std::vector<std::string> replaced;
+    for (size_t i = 0; i < stmt.statements.size(); i++) {
+        auto* var = std::get_if<VarStatement>(&stmt.statements[i]);
+        const Shape* shape = var ? allocation(*var, stmt.statements, i + 1) : nullptr;
+        if (!shape) {
+            replace(stmt.statements[i]);
+            statements.push_back(std::move(stmt.statements[i]));
+            continue;
+        }
+
+        auto& call = std::get<CallExpr>(*var->initializer);
+        const std::string& instance = var->name.lexeme();
+        for (size_t param = 0; param < shape->params.size(); param++) {
+            Expr& argument = call.arguments[param];
+            replace(argument);
+            statements.emplace_back(VarStatement(field(instance, shape->params[param], var->name.line()), std::move(argument)));
+        }
+        for (const auto& [name, literal] : shape->literals) {
+            statements.emplace_back(VarStatement(field(instance, name, var->name.line()), literal));
+        }
+        replaced_.insert(instance);
+        replaced.push_back(instance);
+        stats_.replaced++;
+    }
+    for (const std::string& instance : replaced) {
+        replaced_.erase(instance);
+    }
+    stmt.statements = std::move(statements);
+}
+
+void ScalarReplacement::operator()(ClassStatement& stmt) {
+    for (auto& method : stmt.methods) {
+        operator()(method);
+    }
+}
+
+void ScalarReplacement::operator()(ExprStatement& stmt) {
+    replace(stmt.expr);
+}
+
+void ScalarReplacement::operator()(FunctionStatement& stmt) {
+    operator()(*stmt.body);
+}
+
+void ScalarReplacement::operator()(IfStatement& stmt) {
+    replace(stmt.condition);
+    replace(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        replace(*stmt.elseBranch);
+    }
+}
+
+void ScalarReplacement::operator()(PrintStatement& stmt) {
+    replace(stmt.expr);
+}
+
+void ScalarReplacement::operator()(ReturnStatement& stmt) {
+    if (stmt.value.has_value()) {
+        replace(*stmt.value);
+    }
+}
+
+void ScalarReplacement::operator()(VarStatement& stmt) {
+    if (stmt.initializer.has_value()) {
+        replace(*stmt.initializer);
+    }
+}
+
+void ScalarReplacement::operator()(WhileStatement& stmt) {
+    replace(stmt.condition);
+    operator()(*stmt.body);
+}
+
+// A class only counts from its declaration on, as the top level runs in
+// order and nothing after the declaration can run before it
+void ScalarReplacement::replace(std::vector<Statement>& stmts) {
+    std::unordered_map<std::string, size_t> declarations;
+    std::unordered_set<std::string> assigned;
+    walk(stmts, [&](size_t, const auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, ClassStatement> || std::is_same_v<T, VarStatement>) {
+            declarations[node.name.lexeme()]++;
+        } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+            declarations[node.name.lexeme()]++;
+            for (const Token& param : node.params) {
+                declarations[param.lexeme()]++;
+            }
+        } else if constexpr (std::is_same_v<T, AssignExpr>) {
+            assigned.insert(node.name.lexeme());
+        }
+    });
+
+    classes_.clear();
+    for (Statement& stmt : stmts) {
+        if (auto* klass = std::get_if<ClassStatement>(&stmt)) {
+            const std::string& name = klass->name.lexeme();
+            if (declarations[name] == 1 && !assigned.contains(name)) {
+                if (auto shape = ScalarReplacement::shape(*klass)) {
+                    classes_.emplace(name, std::move(*shape));
+                }
+            }
+        }
+        replace(stmt);
+    }
+}
+
+// `p.f` and `p.f = value` of a replaced `p`
+void ScalarReplacement::replace(Expr& expr) {
+    if (auto* get = std::get_if<GetExpr>(&expr)) {
+        auto* object = std::get_if<VarExpr>(get->object.get());
+        if (object && replaced_.contains(object->name.lexeme())) {
+            expr = VarExpr(field(object->name.lexeme(), get->name.lexeme(), get->name.line()));
+            return;
+        }
+    } else if (auto* set = std::get_if<SetExpr>(&expr)) {
+        auto* object = std::get_if<VarExpr>(set->object.get());
+        if (object && replaced_.contains(object->name.lexeme())) {
+            Token name = field(object->name.lexeme(), set->name.lexeme(), set->name.line());
+            Expr value = std::move(*set->value);
+            expr = AssignExpr(std::move(name), std::move(value));
+        }
+    }
+    std::visit(*this, expr);
+}
+
+void ScalarReplacement::replace(Statement& stmt) {
+    std::visit(*this, stmt);
+}
+
+std::optional<ScalarReplacement::Shape> ScalarReplacement::shape(const ClassStatement& stmt) {
+    if (stmt.superclass.has_value()) {
+        return std::nullopt;
+    }
+    auto init = std::ranges::find_if(stmt.methods, [](const FunctionStatement& method) {
+        return method.name.lexeme() == "init";
+    });
+    if (init == stmt.methods.end()) {
+        return std::nullopt;
+    }
+
+    Shape shape;
+    shape.params.resize(init->params.size());
+    for (const Statement& s : init->body->statements) {
+        auto* expr = std::get_if<ExprStatement>(&s);
+        auto* set = expr ? std::get_if<SetExpr>(&expr->expr) : nullptr;
+        if (!set || !std::holds_alternative<ThisExpr>(*set->object) || !shape.fields.insert(set->name.lexeme()).second) {
+            return std::nullopt;
+        }
+        if (auto* literal = std::get_if<LiteralExpr>(set->value.get())) {
+            shape.literals.emplace_back(set->name.lexeme(), *literal);
+            continue;
+        }
+        auto* var = std::get_if<VarExpr>(set->value.get());
+        if (!var) {
+            return std::nullopt;
+        }
+        auto param = std::ranges::find_if(init->params, [var](const Token& param) {
+            return param.lexeme() == var->name.lexeme();
+        });
+        if (param == init->params.end()) {
+            return std::nullopt;
+        }
+        std::string& field = shape.params[param - init->params.begin()];
+        if (!field.empty()) {
+            return std::nullopt;
+        }
+        field = set->name.lexeme();
+    }
+    if (std::ranges::any_of(shape.params, [](const std::string& field) { return field.empty(); })) {
+        return std::nullopt;
+    }
+    return shape;
+}
+
+const ScalarReplacement::Shape* ScalarReplacement::allocation(const VarStatement& stmt, const std::vector<Statement>& stmts, size_t next) {
+    auto* call = stmt.initializer.has_value() ? std::get_if<CallExpr>(&*stmt.initializer) : nullptr;
+    auto* callee = call ? std::get_if<VarExpr>(call->callee.get()) : nullptr;
+    if (!callee) {
+        return nullptr;
+    }
+    auto it = classes_.find(callee->name.lexeme());
+    if (it == classes_.end()) {
+        return nullptr;
+    }
+    stats_.allocations++;
+    const Shape& shape = it->second;
+    if (call->arguments.size() != shape.params.size()) {
+        return nullptr;
+    }
+
+    // Every mention of the instance has to be the object of a field access,
+    // outside of any function, which would capture it
+    const std::string& instance = stmt.name.lexeme();
+    size_t mentions = 0;
+    size_t fields = 0;
+    bool escapes = false;
+    auto mention = [&](size_t, const auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, VarExpr>) {
+            mentions += node.name.lexeme() == instance;
+        } else if constexpr (std::is_same_v<T, GetExpr> || std::is_same_v<T, SetExpr>) {
+            auto* object = std::get_if<VarExpr>(node.object.get());
+            if (object && object->name.lexeme() == instance) {
+                escapes = escapes || !shape.fields.contains(node.name.lexeme());
+                fields++;
+            }
+        } else if constexpr (std::is_same_v<T, AssignExpr> || std::is_same_v<T, VarStatement> || std::is_same_v<T, ClassStatement>) {
+            escapes = escapes || node.name.lexeme() == instance;
+        } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+            escapes = escapes || node.name.lexeme() == instance || std::ranges::any_of(node.params, [&](const Token& param) {
+                return param.lexeme() == instance;
+            });
+            size_t captured = 0;
+            walk(node.body->statements, [&](size_t, const auto& inner) {
+                if constexpr (std::is_same_v<std::decay_t<decltype(inner)>, VarExpr>) {
+                    captured += inner.name.lexeme() == instance;
+                }
+            });
+            escapes = escapes || captured > 0;
+        }
+    };
+    PreOrder order(mention);
+    for (const Expr& argument : call->arguments) {
+        order.walk(argument);
+    }
+    if (mentions > 0) {
+        return nullptr;
+    }
+    for (size_t i = next; i < stmts.size(); i++) {
+        order.walk(stmts[i]);
+    }
+    return escapes || mentions != fields ? nullptr : &shape;
+}
+
+Token ScalarReplacement::field(const std::string& instance, const std::string& name, int line) {
+    return Token(TokenType::IDENTIFIER, instance + "." + name, std::nullopt, line);
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+
+namespace cpplox {
+
+// Replaces instances that never escape the block creating them with a local
+// per field, so that they are never allocated. Runs on parsed programs,
+// before the Resolver, which then resolves the fields like any other local.
+//
+// An instance is replaced when it is created by `var p = C(arguments);` and
+// the rest of the block only reads and assigns its fields, as `p.f` and
+// `p.f = value`. Passing, returning, printing, comparing, assigning or
+// capturing it, or calling one of its methods, lets it escape. Its fields
+// become locals named `p.f`, which no identifier can clash with.
+//
+// C is a class without a superclass, declared at the top level before the
+// block by a name that the program declares once and never assigns. Its
+// init() only sets fields, each to a literal or to a parameter, using every
+// parameter once. The arguments then initialize the fields in order, and
+// every field the instance could have is set from the start.
+class ScalarReplacement {
+public:
+    struct Stats {
+        // Instances created by a `var` in a block, and those replaced
+        size_t allocations = 0;
+        size_t replaced = 0;
+
+        Stats& operator+=(const Stats& other) {
+            allocations += other.allocations;
+            replaced += other.replaced;
+            return *this;
+        }
+    };
+
+    void operator()(AssignExpr& expr);
+    void operator()(BinaryExpr& expr);
+    void operator()(CallExpr& expr);
+    void operator()(GetExpr& expr);
+    void operator()(GroupingExpr& expr);
+    void operator()(LiteralExpr& expr);
+    void operator()(LogicalExpr& expr);
+    void operator()(SetExpr& expr);
+    void operator()(SuperExpr& expr);
+    void operator()(ThisExpr& expr);
+    void operator()(UnaryExpr& expr);
+    void operator()(VarExpr& expr);
+    void operator()(LocalCompareExpr& expr);
+    void operator()(LocalIncrementExpr& expr);
+    void operator()(ThisGetExpr& expr);
+    void operator()(InvokeExpr& expr);
+
+    void operator()(BlockStatement& stmt);
+    void operator()(ClassStatement& stmt);
+    void operator()(ExprStatement& stmt);
+    void operator()(FunctionStatement& stmt);
+    void operator()(IfStatement& stmt);
+    void operator()(PrintStatement& stmt);
+    void operator()(ReturnStatement& stmt);
+    void operator()(VarStatement& stmt);
+    void operator()(WhileStatement& stmt);
+
+    void replace(std::vector<Statement>& stmts);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+private:
+    // What init() does with the instances of a class
+    struct Shape {
+        // The field each parameter initializes
+        std::vector<std::string> params;
+        std::vector<std::pair<std::string, LiteralExpr>> literals;
+        std::unordered_set<std::string> fields;
+    };
+
+    void replace(Expr& expr);
+    void replace(Statement& stmt);
+
+    static std::optional<Shape> shape(const ClassStatement& stmt);
+    // The shape of the instance `stmt` creates, if it doesn't escape the
+    // statements of its block from `next` on
+    const Shape* allocation(const VarStatement& stmt, const std::vector<Statement>& stmts, size_t next);
+    // The local standing in for field `name` of `instance`
+    static Token field(const std::string& instance, const std::string& name, int line);
+
+    std::unordered_map<std::string, Shape> classes_;
+    // Instances replaced in the blocks being rewritten
+    std::unordered_set<std::string> replaced_;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
@@ -1,11 +1,21 @@
+#include <algorithm>
+#include <sstream>
 #include <string>
 #include <format>
 #include <memory>
+#include <thread>
+#include <vector>
 
+#include <driver/driver.h>
 #include <env/interpreter.h>
 #include <env/object.h>
+#include <env/region.h>
+#include <env/test/prepared.h>
+#include <env/tiering.h>
+#include <util/slab.h>
 
 #include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
 
 using namespace cpplox;
 
@@ -16,7 +26,7 @@ TEST_CASE("IntegerAddition") {
     Expr expr{ BinaryExpr{ LiteralExpr{1.0}, { TokenType::PLUS, "+", std::nullopt, 0 }, LiteralExpr{2.0} } };
     auto object = interpreter.interpretExpr(expr);
     REQUIRE(object.has_value());
-    REQUIRE(std::get<double>(*object) == 3.0);
+    REQUIRE(std::get<int64_t>(*object) == 3);
 }
 
 TEST_CASE("StringConcat") {
@@ -48,3 +58,432 @@ TEST_CASE("LogicalAnd") {
     REQUIRE(object.has_value());
     REQUIRE(std::get<std::string>(*object) == "world");
 }
+
+TEST_CASE("BinarySpecialization") {
+    Diagnostic d;
+    Interpreter interpreter{ d };
+    // 1.0 + 2.0, twice
+    Expr expr{ BinaryExpr{ LiteralExpr{1.0}, { TokenType::PLUS, "+", std::nullopt, 0 }, LiteralExpr{2.0} } };
+    REQUIRE(std::get<BinaryExpr>(expr).specialization == Specialization::Uninitialized);
+    interpreter.interpretExpr(expr);
+    REQUIRE(std::get<BinaryExpr>(expr).specialization == Specialization::Number);
+    auto object = interpreter.interpretExpr(expr);
+    REQUIRE(object.has_value());
+    REQUIRE(std::get<int64_t>(*object) == 3);
+}
+
+TEST_CASE("BinarySpecializationGuard") {
+    Diagnostic d;
+    Interpreter interpreter{ d };
+    // "hello" + " world", specialized to numbers
+    Expr expr{ BinaryExpr{ LiteralExpr{"hello"}, { TokenType::PLUS, "+", std::nullopt, 0 }, LiteralExpr{" world"} } };
+    std::get<BinaryExpr>(expr).specialization = Specialization::Number;
+    auto object = interpreter.interpretExpr(expr);
+    REQUIRE(std::get<BinaryExpr>(expr).specialization == Specialization::Generic);
+    REQUIRE(object.has_value());
+    REQUIRE(std::get<std::string>(*object) == "hello world");
+}
+
+TEST_CASE("TieringPublishes") {
+    Diagnostic d;
+    Interpreter interpreter{ d };
+    // fun f() {}
+    FunctionStatement function{ { TokenType::IDENTIFIER, "f", std::nullopt, 0 }, {}, BlockStatement{ std::vector<Statement>{} } };
+    std::atomic<int> compiles = 0;
+    Tiering tiering(
+        [&compiles](const FunctionStatement&) -> BlockCode {
+            compiles++;
+            return [](Interpreter&, EnvironmentPtr) -> std::optional<Object> {
+                return 42.0;
+            };
+        },
+        [](const WhileStatement&) -> StatementCode {
+            return {};
+        });
+
+    const auto& slot = tiering.compile(function);
+    REQUIRE(&tiering.compile(function) == &slot);
+    while (!slot.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+    auto ret = (*slot.load())(interpreter, nullptr);
+    REQUIRE(ret.has_value());
+    REQUIRE(std::get<double>(*ret) == 42.0);
+    REQUIRE(compiles == 1);
+    REQUIRE(tiering.stats().functions == 1);
+    REQUIRE(tiering.stats().loops == 0);
+}
+
+TEST_CASE("ReturnCompletion") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    // Returns from deep in loops, past the trace threshold, and a call after
+    // them that returns nothing. A bare return leaves the function too.
+    driver.run(R"(
+        fun find(n) {
+            for (var i = 0; i < 1000; i = i + 1) {
+                var j = 0;
+                while (j < 3) {
+                    if (i * 3 + j == n) {
+                        return i;
+                    }
+                    j = j + 1;
+                }
+            }
+            return -1;
+        }
+        fun nothing() {}
+        class Counter {
+            init() {
+                this.n = 0;
+                return;
+            }
+            next() {
+                this.n = this.n + 1;
+                return this.n;
+            }
+        }
+        print find(400);
+        print nothing();
+        var c = Counter();
+        c.next();
+        print c.next();
+        print find(5000);
+        fun spin(n) {
+            var i = 0;
+            while (true) {
+                i = i + 1;
+                if (i == n) {
+                    return;
+                }
+            }
+        }
+        fun once(n) {
+            print n;
+            return;
+            print n;
+        }
+        print spin(500);
+        once(1);
+    )");
+    REQUIRE(ss.str() == "133\nnil\n2\n-1\nnil\n1\n");
+}
+
+TEST_CASE("BorrowedOperands") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    // An operand that assigns the variable read before it sees the old value
+    driver.run(R"(
+        var a = "left";
+        print a + (a = "right");
+        print a == a;
+        var n = 1;
+        print n + (n = 10) + n;
+        class Box {
+            init(v) {
+                this.v = v;
+            }
+            get() {
+                return this.v;
+            }
+            after(x) {
+                return this.v;
+            }
+        }
+        var box = Box("boxed");
+        print box.v;
+        print box.get() + box.v;
+        var b = box;
+        print b.after(b = nil);
+    )");
+    REQUIRE(ss.str() == "\"leftright\"\ntrue\n21\n\"boxed\"\n\"boxedboxed\"\n\"boxed\"\n");
+}
+
+TEST_CASE("EnvironmentPool") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure));
+    auto before = EnvironmentPool::instance().stats();
+    // Counters each get their own environment, fresh or recycled, while the
+    // bound methods' environments come and go
+    driver.run(R"(
+        fun counter(start) {
+            var n = start;
+            fun next() {
+                n = n + 1;
+                return n;
+            }
+            return next;
+        }
+        class Box {
+            init(v) {
+                this.v = v;
+            }
+            get() {
+                return this.v;
+            }
+        }
+        var total = 0;
+        for (var i = 0; i < 100; i = i + 1) {
+            var next = counter(i);
+            next();
+            total = total + next() + Box(i).get();
+        }
+        print total;
+        var a = counter(10);
+        var b = counter(20);
+        a();
+        print a() + b();
+    )");
+    REQUIRE(ss.str() == "10100\n33\n");
+    auto after = EnvironmentPool::instance().stats();
+    REQUIRE(after.hits > before.hits);
+}
+
+TEST_CASE("InstanceSlab") {
+    Slab slab(sizeof(Instance), alignof(Instance));
+    std::vector<void*> slots;
+    for (size_t i = 0; i <= Slab::chunkSize; i++) {
+        slots.push_back(slab.allocate());
+    }
+    // Packed within a chunk
+    REQUIRE(static_cast<std::byte*>(slots[1]) - static_cast<std::byte*>(slots[0]) == sizeof(Instance));
+    slab.deallocate(slots[3]);
+    REQUIRE(slab.allocate() == slots[3]);
+
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure));
+    // Instances outlive the variable their class was in, and their slots are
+    // taken again by later ones
+    driver.run(R"(
+        class Node {
+            init(value, next) {
+                this.value = value;
+                this.next = next;
+            }
+        }
+        var list = nil;
+        for (var i = 0; i < 200; i = i + 1) {
+            list = Node(i, list);
+        }
+        Node = nil;
+        var sum = 0;
+        while (list != nil) {
+            sum = sum + list.value;
+            list = list.next;
+        }
+        print sum;
+    )");
+    REQUIRE(ss.str() == "19900\n");
+}
+
+TEST_CASE("Region") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure));
+    // A list too long to free one node after the other by recursion, and a
+    // function that captures itself, which counting alone never frees
+    driver.run(R"(
+        class Node {
+            init(next) {
+                this.next = next;
+            }
+        }
+        var list = nil;
+        for (var i = 0; i < 100000; i = i + 1) {
+            list = Node(list);
+        }
+        fun outer() {
+            fun self() {
+                return self;
+            }
+            return self;
+        }
+        var cycle = outer();
+        print cycle() == cycle;
+    )");
+    REQUIRE(ss.str() == "true\n");
+    REQUIRE(driver.regionStats().freed > 100000);
+    REQUIRE(driver.regionStats().exported == 0);
+
+    // What the host still holds is exported, with what it reaches
+    EnvironmentPtr kept;
+    Region::Stats stats;
+    {
+        Region region;
+        kept = Environment::make(Environment::make());
+        kept->enclosing()->define("x", 1.0);
+        region.release();
+        stats = region.stats();
+    }
+    REQUIRE(stats.exported == 2);
+    REQUIRE(*kept->findAt(1, "x") == Object{ 1.0 });
+}
+
+TEST_CASE("DeferredRelease") {
+    // Dropping a chain far deeper than the stack destroys it in a loop
+    EnvironmentPtr chain;
+    for (size_t i = 0; i < 1000000; i++) {
+        chain = Environment::make(std::move(chain));
+    }
+    chain = nullptr;
+
+    ReleaseQueue& queue = ReleaseQueue::instance();
+    for (size_t i = 0; i < 100; i++) {
+        chain = Environment::make(std::move(chain));
+    }
+    queue.defer();
+    chain = nullptr;
+    REQUIRE(queue.size() == 1);
+    // One link at a time, each queueing the next
+    REQUIRE(queue.drain(10) == 10);
+    REQUIRE(queue.size() == 1);
+    queue.resume();
+    REQUIRE(queue.drain() == 90);
+    REQUIRE(queue.size() == 0);
+
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure));
+    driver.deferReleases(8);
+    driver.run(R"(
+        class Node {
+            init(value, next) {
+                this.value = value;
+                this.next = next;
+            }
+        }
+        var sum = 0;
+        for (var round = 0; round < 3; round = round + 1) {
+            var list = nil;
+            for (var i = 0; i < 1000; i = i + 1) {
+                list = Node(i, list);
+            }
+            sum = sum + list.value;
+        }
+        print sum;
+    )");
+    REQUIRE(ss.str() == "2997\n");
+}
+
+TEST_CASE("StackOverflow") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.limitDepth(1000);
+    // Deeper than the native stack of the thread would take
+    driver.run(R"(
+        fun depth(n) {
+            if (n == 0) return 0;
+            return depth(n - 1) + 1;
+        }
+        print depth(999);
+        print depth(1000000);
+        print "unreachable";
+    )");
+    REQUIRE(ss.str() == "999\n");
+}
+
+TEST_CASE("NestedStackOverflow") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.limitDepth(1000);
+    // Every call nests 200 expressions, more native stack than the depth
+    // allows for, so the stack runs low well before 1000 calls. The print
+    // keeps the function out of the JIT.
+    std::string call = "f(n - 1)";
+    for (int i = 0; i < 200; i++) {
+        call = std::format("(0 + {})", call);
+    }
+    driver.run(std::format(R"(
+        fun f(n) {{
+            if (n < 0) print n;
+            if (n == 0) return 0;
+            return {};
+        }}
+        print f(10);
+        print f(999);
+        print "unreachable";
+    )", call));
+    REQUIRE(ss.str() == "0\n");
+}
+
+TEST_CASE("SpecializedConstructor") {
+    const std::string program = R"(
+        class Pair {
+            init(a, b) {
+                this.first = a;
+                this.second = b;
+                this.count = 0;
+                this.same = a;
+            }
+        }
+        class Origin {
+            init() {
+                this.x = 0;
+                this.y = 0;
+            }
+        }
+        class Marked < Origin {
+            sum() {
+                return this.x + this.y + 7;
+            }
+        }
+        class Loud {
+            init(x) {
+                print x;
+                this.x = x;
+            }
+        }
+        var p = Pair(1, 2);
+        print p.first + p.second + p.count + p.same;
+        print Marked().sum();
+        var l = Loud(5);
+        print l.x;
+        print p.init(7, 8).first;
+        print p.second;
+    )";
+    Prepared prepared(program);
+    Interpreter& interpreter = prepared.interpreter;
+    const auto& stmts = prepared.stmts;
+    REQUIRE(interpreter.constructor(std::get<ClassStatement>(stmts[0])) != nullptr);
+    // Integral literals are held as integers, as everywhere else
+    const auto& fields = interpreter.constructor(std::get<ClassStatement>(stmts[0]))->fields;
+    auto count = std::ranges::find_if(fields, [](const Constructor::Field& field) { return field.name == "count"; });
+    REQUIRE(count != fields.end());
+    REQUIRE(std::get<int64_t>(count->value) == 0);
+    REQUIRE(interpreter.constructor(std::get<ClassStatement>(stmts[1])) != nullptr);
+    // Inherits Origin's when created
+    REQUIRE(interpreter.constructor(std::get<ClassStatement>(stmts[2])) == nullptr);
+    REQUIRE(interpreter.constructor(std::get<ClassStatement>(stmts[3])) == nullptr);
+
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.run(program);
+    REQUIRE(ss.str() == "4\n7\n5\n5\n7\n8\n");
+}
+
+TEST_CASE("IntegerNumbers") {
+    const std::string program = R"(
+        var big = 9007199254740992;
+        print big + 1;
+        print big * 2 - big;
+        print 0 * -1;
+        print -0;
+        print 1 / 2;
+        print 6 / 3;
+        print 1 == 1.0;
+        print 10000000000000000;
+        fun add(a, b) { return a + b; }
+        var sum = 0;
+        for (var i = 0; i < 200; i = i + 1) {
+            sum = add(sum, i);
+        }
+        print sum;
+        var half = 0;
+        for (var i = 0; i < 300; i = i + 1) {
+            half = half + 0.5;
+        }
+        print half;
+    )";
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.run(program);
+    REQUIRE(ss.str() == "9007199254740992\n9007199254740992\n-0\n-0\n0.5\n2\ntrue\n1e+16\n19900\n150\n");
+}
\ No newline at end of file
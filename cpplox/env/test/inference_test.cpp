@@ -0,0 +1,106 @@
+#include <string>
+
+#include <env/inference.h>
+#include <env/test/prepared.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cpplox;
+
+namespace {
+
+// Infers the program's types and runs it, returning what it printed
+std::string run(const std::string& program, TypeInference::Stats& stats) {
+    Prepared prepared(program);
+    TypeInference inference(prepared.interpreter);
+    inference.infer(prepared.stmts);
+    stats = inference.stats();
+    return prepared.run();
+}
+
+}
+
+TEST_CASE("InferenceLocals") {
+    TypeInference::Stats stats;
+    auto out = run(R"(
+        {
+            var a = 1;
+            var b = a * 2;
+            var c = (b + a) / 3;
+            print -c;
+            var s = "x";
+            print s + "y";
+            print a < b;
+        }
+    )", stats);
+    REQUIRE(out == "-1\n\"xy\"\ntrue\n");
+    REQUIRE(stats.binaries == 5);
+    REQUIRE(stats.provenBinaries == 4);
+    REQUIRE(stats.negations == 1);
+    REQUIRE(stats.provenNegations == 1);
+}
+
+TEST_CASE("InferenceUnknowns") {
+    TypeInference::Stats stats;
+    auto out = run(R"(
+        var global = 1;
+        print global + 1;
+        fun f(n) {
+            return n * 2;
+        }
+        print f(2);
+        {
+            var outer = 1;
+            fun g() {
+                return outer + 1;
+            }
+            print g();
+            var maybe;
+            print -(maybe or 1);
+        }
+    )", stats);
+    REQUIRE(out == "2\n4\n2\n-1\n");
+    REQUIRE(stats.binaries == 3);
+    REQUIRE(stats.provenBinaries == 0);
+    REQUIRE(stats.provenNegations == 0);
+}
+
+TEST_CASE("InferenceLoops") {
+    TypeInference::Stats stats;
+    auto out = run(R"(
+        {
+            var x = 0;
+            var sum = 0;
+            for (var i = 0; i < 3; i = i + 1) {
+                print x == 0;
+                x = "s";
+                sum = sum + i;
+            }
+            print sum;
+        }
+    )", stats);
+    REQUIRE(out == "true\nfalse\nfalse\n3\n");
+    // All but `x == 0`
+    REQUIRE(stats.binaries == 4);
+    REQUIRE(stats.provenBinaries == 3);
+}
+
+TEST_CASE("InferenceClosures") {
+    TypeInference::Stats stats;
+    auto out = run(R"(
+        {
+            var n = 1;
+            print n + 1;
+            fun f() {
+                n = "s";
+            }
+            f();
+            print n == 1;
+            n = 2;
+            print n == 2;
+        }
+    )", stats);
+    REQUIRE(out == "2\nfalse\ntrue\n");
+    REQUIRE(stats.binaries == 3);
+    REQUIRE(stats.provenBinaries == 1);
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <diagnostic/diagnostic.h>
+#include <env/interpreter.h>
+#include <env/optimizer.h>
+#include <env/resolver.h>
+#include <parser/parser.h>
+#include <scanner/scanner.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+namespace cpplox {
+
+// A program scanned, parsed and resolved as the driver does it, for tests
+// of the passes that come after, which they run on `stmts` themselves
+struct Prepared {
+    Diagnostic diagnostic;
+    std::stringstream out;
+    Interpreter interpreter{ diagnostic, out };
+    std::vector<Statement> stmts;
+
+    explicit Prepared(const std::string& source) {
+        Scanner scanner(source, diagnostic);
+        auto tokens = scanner.scanTokens();
+        Parser parser(tokens, diagnostic);
+        auto parsed = parser.parse();
+        REQUIRE(parsed.has_value());
+        stmts = std::move(*parsed);
+        Resolver(interpreter).resolve(stmts);
+    }
+
+    void optimize() {
+        Optimizer(interpreter).optimize(stmts);
+    }
+
+    // Interprets the program, returning what it printed
+    std::string run() {
+        interpreter.interpret(stmts);
+        REQUIRE(!diagnostic.hadError());
+        return out.str();
+    }
+};
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include <sstream>
+#include <string>
+
+#include <driver/driver.h>
+#include <env/interpreter.h>
+#include <env/memo.h>
+#include <env/purity.h>
+#include <env/test/prepared.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+using namespace cpplox;
+
+TEST_CASE("PurityAnalysis") {
+    const std::string program = R"(
+        fun fib(n) {
+            if (n < 2) return n;
+            return fib(n - 2) + fib(n - 1);
+        }
+        fun sum(n) {
+            var total = 0;
+            for (var i = 0; i < n; i = i + 1) {
+                total = total + fib(i);
+            }
+            return total;
+        }
+        fun say(n) {
+            print n;
+        }
+        var offset = 1;
+        fun shifted(n) {
+            return n + offset;
+        }
+        fun loud(n) {
+            say(n);
+            return n;
+        }
+        fun timed() {
+            return clock();
+        }
+        class Box {
+            get(n) {
+                return n;
+            }
+        }
+    )";
+    Prepared prepared(program);
+    Interpreter& interpreter = prepared.interpreter;
+    PurityAnalysis purity(interpreter);
+    purity.analyze(prepared.stmts);
+
+    auto function = [&](size_t i) -> const FunctionStatement& {
+        return std::get<FunctionStatement>(prepared.stmts[i]);
+    };
+    REQUIRE(interpreter.isPure(function(0)));
+    REQUIRE(interpreter.isPure(function(1)));
+    REQUIRE(!interpreter.isPure(function(2)));
+    REQUIRE(!interpreter.isPure(function(4)));
+    REQUIRE(!interpreter.isPure(function(5)));
+    REQUIRE(!interpreter.isPure(function(6)));
+    REQUIRE(!interpreter.isPure(std::get<ClassStatement>(prepared.stmts[7]).methods[0]));
+    REQUIRE(purity.stats().functions == 6);
+    REQUIRE(purity.stats().pure == 2);
+}
+
+TEST_CASE("MemoEviction") {
+    Memo memo(2);
+    std::vector<Object> one{ 1.0 };
+    std::vector<Object> two{ std::string("two") };
+    std::vector<Object> three{ 3.0, true };
+    memo.insert(one, 10.0);
+    memo.insert(two, 20.0);
+    REQUIRE(std::get<double>(*memo.find(one)) == 10.0);
+    // `two` is now the least recently used
+    memo.insert(three, 30.0);
+    REQUIRE(memo.find(two) == nullptr);
+    REQUIRE(std::get<double>(*memo.find(one)) == 10.0);
+    REQUIRE(std::get<double>(*memo.find(three)) == 30.0);
+    REQUIRE(memo.stats().hits == 3);
+    REQUIRE(memo.stats().misses == 1);
+    REQUIRE(memo.stats().evictions == 1);
+
+    REQUIRE(Memo::cacheable({ nullptr, true, 1.0, std::string("s") }));
+    REQUIRE(!Memo::cacheable({ -0.0 }));
+    REQUIRE(!Memo::cacheable({ FunctionPtr() }));
+}
+
+TEST_CASE("Memoization") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.memoize(16);
+    // Exponential without the cache
+    driver.run(R"(
+        fun fib(n) {
+            if (n < 2) return n;
+            return fib(n - 2) + fib(n - 1);
+        }
+        print fib(70);
+        print fib(10);
+    )");
+    REQUIRE(ss.str() == "190392490709135\n55\n");
+}
\ No newline at end of file
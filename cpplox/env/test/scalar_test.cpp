@@ -0,0 +1,65 @@
+#include <sstream>
+#include <string>
+
+#include <driver/driver.h>
+#include <env/scalar.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+using namespace cpplox;
+
+TEST_CASE("ScalarReplacement") {
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.run(R"(
+        class Point {
+            init(x, y) {
+                this.x = x;
+                this.y = y;
+                this.visits = 0;
+            }
+            sum() {
+                return this.x + this.y;
+            }
+        }
+        fun walk(n) {
+            var total = 0;
+            for (var i = 0; i < n; i = i + 1) {
+                var p = Point(i, i * 2);
+                p.x = p.x + 1;
+                p.visits = p.visits + 1;
+                total = total + p.x + p.y + p.visits;
+            }
+            return total;
+        }
+        fun kept() {
+            var p = Point(1, 2);
+            return p;
+        }
+        fun called() {
+            var p = Point(3, 4);
+            return p.sum();
+        }
+        fun extended() {
+            var p = Point(5, 6);
+            p.z = 7;
+            return p.x + p.z;
+        }
+        fun trace(n) {
+            print n;
+            return n;
+        }
+        print walk(100);
+        print kept().y;
+        print called();
+        print extended();
+        {
+            var p = Point(trace(1), trace(2));
+            print p.y - p.x;
+        }
+    )");
+    REQUIRE(ss.str() == "15050\n2\n7\n12\n1\n2\n1\n");
+    REQUIRE(driver.scalarStats().allocations == 5);
+    REQUIRE(driver.scalarStats().replaced == 2);
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include <env/tiering.h>
+
+namespace cpplox {
+
+Tiering::Tiering(FunctionCompiler compileFunction, LoopCompiler compileLoop) : compileFunction_(std::move(compileFunction)), compileLoop_(std::move(compileLoop)) {}
+
+Tiering::~Tiering() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+const Tiering::Slot<BlockCode>& Tiering::compile(const FunctionStatement& function) {
+    std::unique_lock lock(mutex_);
+    auto [it, inserted] = functions_.try_emplace(&function);
+    auto& entry = it->second;
+    if (inserted) {
+        lock.unlock();
+        request([this, &function, &entry]() {
+            publish(entry, compileFunction_(function));
+        });
+    }
+    return entry.slot;
+}
+
+const Tiering::Slot<StatementCode>& Tiering::compile(const WhileStatement& loop) {
+    std::unique_lock lock(mutex_);
+    auto [it, inserted] = loops_.try_emplace(&loop);
+    auto& entry = it->second;
+    if (inserted) {
+        lock.unlock();
+        request([this, &loop, &entry]() {
+            publish(entry, compileLoop_(loop));
+        });
+    }
+    return entry.slot;
+}
+
+void Tiering::cancel() {
+    std::unique_lock lock(mutex_);
+    queue_.clear();
+    idle_.wait(lock, [this]() {
+        return !busy_;
+    });
+}
+
+Tiering::Stats Tiering::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+bool Tiering::requested(const FunctionStatement& function) const {
+    std::lock_guard lock(mutex_);
+    return functions_.contains(&function);
+}
+
+void Tiering::request(std::function<void()> job) {
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(job));
+        if (!worker_.joinable()) {
+            worker_ = std::thread(&Tiering::work, this);
+        }
+    }
+    wake_.notify_one();
+}
+
+template <typename Code>
+void Tiering::publish(Entry<Code>& entry, Code code) {
+    std::lock_guard lock(mutex_);
+    entry.code = std::make_unique<const Code>(std::move(code));
+    entry.slot.store(entry.code.get(), std::memory_order_release);
+    if constexpr (std::is_same_v<Code, BlockCode>) {
+        stats_.functions++;
+    } else {
+        stats_.loops++;
+    }
+}
+
+void Tiering::work() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        wake_.wait(lock, [this]() {
+            return stopping_ || !queue_.empty();
+        });
+        if (stopping_) {
+            return;
+        }
+        auto job = std::move(queue_.front());
+        queue_.pop_front();
+        busy_ = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        busy_ = false;
+        idle_.notify_all();
+    }
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <ast/statement.h>
+#include <env/fwd.h>
+
+namespace cpplox {
+
+// Iterations of one run of an untraced loop after which it is compiled, and
+// continued in compiled code once that is ready
+constexpr size_t osrThreshold = 1000;
+
+// Promotes hot functions and loops from the tree-walker to the closure
+// compiler. Compiles run one at a time on a background thread that starts
+// with the first request, and their code is published through an atomic
+// slot the interpreter checks on its way; until it shows up the interpreter
+// keeps walking the tree, so it never waits for the compiler.
+//
+// The compilers are called on the background thread. They may read the
+// resolver's tables, which stay put while a program runs, but must not touch
+// runtime objects, whose reference counts aren't atomic; what they hand
+// back crosses over as plain code.
+class Tiering {
+public:
+    using FunctionCompiler = std::function<BlockCode(const FunctionStatement&)>;
+    using LoopCompiler = std::function<StatementCode(const WhileStatement&)>;
+
+    template <typename Code>
+    using Slot = std::atomic<const Code*>;
+
+    struct Stats {
+        size_t functions = 0;
+        size_t loops = 0;
+    };
+
+    Tiering(FunctionCompiler compileFunction, LoopCompiler compileLoop);
+    ~Tiering();
+
+    Tiering(const Tiering&) = delete;
+    Tiering& operator=(const Tiering&) = delete;
+
+    // Requests compiled code for the function's body, or for the loop
+    const Slot<BlockCode>& compile(const FunctionStatement& function);
+    const Slot<StatementCode>& compile(const WhileStatement& loop);
+
+    // Drops the requests not started yet and waits for the one in progress,
+    // before the program they refer to goes away
+    void cancel();
+
+    Stats stats() const;
+
+    // Whether the function's body was requested
+    bool requested(const FunctionStatement& function) const;
+
+private:
+    template <typename Code>
+    struct Entry {
+        std::unique_ptr<const Code> code;
+        Slot<Code> slot{ nullptr };
+    };
+
+    void request(std::function<void()> job);
+    template <typename Code>
+    void publish(Entry<Code>& entry, Code code);
+    void work();
+
+    FunctionCompiler compileFunction_;
+    LoopCompiler compileLoop_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> queue_;
+    bool busy_ = false;
+    bool stopping_ = false;
+    std::unordered_map<const FunctionStatement*, Entry<BlockCode>> functions_;
+    std::unordered_map<const WhileStatement*, Entry<StatementCode>> loops_;
+    Stats stats_;
+    std::thread worker_;
+};
+
+} // cpplox
\ No newline at end of file
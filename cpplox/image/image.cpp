@@ -0,0 +1,591 @@
+#include <image/image.h>
+
+#include <format>
+#include <variant>
+
+#include <util/literal.h>
+#include <util/traits.h>
+
+namespace cpplox {
+
+void ImageWriter::operator()(const AssignExpr& expr) {
+    write(expr.name);
+    writeDepth(&expr);
+    write(*expr.object);
+}
+
+void ImageWriter::operator()(const BinaryExpr& expr) {
+    write(expr.op);
+    write(*expr.left);
+    write(*expr.right);
+}
+
+void ImageWriter::operator()(const CallExpr& expr) {
+    write(expr.paren);
+    write(*expr.callee);
+    writeArguments(expr.arguments);
+}
+
+void ImageWriter::operator()(const GetExpr& expr) {
+    write(expr.name);
+    write(*expr.object);
+}
+
+void ImageWriter::operator()(const GroupingExpr& expr) {
+    write(*expr.expr);
+}
+
+// Nil, a number or a string
+void ImageWriter::operator()(const LiteralExpr& expr) {
+    if (!expr.object.has_value()) {
+        write(0);
+    } else if (auto* number = std::get_if<double>(&*expr.object)) {
+        write(1);
+        writeNumber(*number);
+    } else {
+        write(2);
+        write(std::get<std::string>(*expr.object));
+    }
+}
+
+void ImageWriter::operator()(const LogicalExpr& expr) {
+    write(expr.op);
+    write(*expr.left);
+    write(*expr.right);
+}
+
+void ImageWriter::operator()(const SetExpr& expr) {
+    write(expr.name);
+    write(*expr.object);
+    write(*expr.value);
+}
+
+void ImageWriter::operator()(const SuperExpr& expr) {
+    write(expr.keyword);
+    write(expr.method);
+    writeDepth(&expr);
+    writeDepth(&expr.method);
+}
+
+void ImageWriter::operator()(const ThisExpr& expr) {
+    write(expr.keyword);
+    writeDepth(&expr);
+}
+
+void ImageWriter::operator()(const UnaryExpr& expr) {
+    write(expr.op);
+    write(*expr.right);
+}
+
+void ImageWriter::operator()(const VarExpr& expr) {
+    write(expr.name);
+    writeDepth(&expr);
+}
+
+void ImageWriter::operator()(const LocalCompareExpr& expr) {
+    write(expr.left);
+    write(expr.leftDepth);
+    write(static_cast<uint32_t>(expr.op));
+    write(expr.right);
+    write(expr.rightDepth);
+    write(expr.line);
+}
+
+void ImageWriter::operator()(const LocalIncrementExpr& expr) {
+    write(expr.name);
+    write(expr.depth);
+    write(static_cast<uint32_t>(expr.op));
+    writeNumber(expr.step);
+    write(expr.line);
+}
+
+void ImageWriter::operator()(const ThisGetExpr& expr) {
+    write(expr.depth);
+    write(expr.name);
+    write(expr.line);
+}
+
+void ImageWriter::operator()(const InvokeExpr& expr) {
+    write(expr.name);
+    write(expr.paren);
+    write(*expr.object);
+    writeArguments(expr.arguments);
+}
+
+void ImageWriter::operator()(const BlockStatement& stmt) {
+    write(static_cast<uint32_t>(interpreter_.blockScope(stmt)));
+    write(stmt.statements.size());
+    for (const Statement& s : stmt.statements) {
+        write(s);
+    }
+}
+
+void ImageWriter::operator()(const ClassStatement& stmt) {
+    write(stmt.name);
+    write(stmt.superclass.has_value());
+    if (stmt.superclass.has_value()) {
+        write(stmt.superclass->name);
+        writeDepth(&*stmt.superclass);
+    }
+    writeCaptures(&stmt);
+    write(stmt.methods.size());
+    for (const FunctionStatement& method : stmt.methods) {
+        writeFunction(method);
+    }
+}
+
+void ImageWriter::operator()(const ExprStatement& stmt) {
+    write(stmt.expr);
+}
+
+void ImageWriter::operator()(const FunctionStatement& stmt) {
+    writeFunction(stmt);
+}
+
+void ImageWriter::operator()(const IfStatement& stmt) {
+    write(stmt.elseBranch != nullptr);
+    write(stmt.condition);
+    write(*stmt.thenBranch);
+    if (stmt.elseBranch) {
+        write(*stmt.elseBranch);
+    }
+}
+
+void ImageWriter::operator()(const PrintStatement& stmt) {
+    write(stmt.expr);
+}
+
+void ImageWriter::operator()(const ReturnStatement& stmt) {
+    write(stmt.keyword);
+    write(stmt.value.has_value());
+    if (stmt.value.has_value()) {
+        write(*stmt.value);
+    }
+}
+
+void ImageWriter::operator()(const VarStatement& stmt) {
+    write(stmt.name);
+    write(stmt.initializer.has_value());
+    if (stmt.initializer.has_value()) {
+        write(*stmt.initializer);
+    }
+}
+
+void ImageWriter::operator()(const WhileStatement& stmt) {
+    write(stmt.condition);
+    operator()(*stmt.body);
+}
+
+void ImageWriter::write(const std::vector<Statement>& stmts) {
+    write(stmts.size());
+    for (const Statement& stmt : stmts) {
+        write(stmt);
+    }
+}
+
+ProgramImage ImageWriter::image() {
+    views_.assign(strings_.begin(), strings_.end());
+    return { code_, views_, numbers_ };
+}
+
+std::string ImageWriter::header(const std::string& name, const std::string& source) const {
+    std::string code;
+    for (size_t i = 0; i < code_.size(); i++) {
+        code += std::format("{}{}", i % 16 ? " " : "\n    ", code_[i]);
+        code += ",";
+    }
+
+    std::string strings;
+    for (const std::string& string : strings_) {
+        strings += std::format("\n    std::string_view({}, {}),", cppString(string), string.size());
+    }
+    std::string numbers;
+    for (double number : numbers_) {
+        numbers += std::format("\n    {},", cppNumber(number));
+    }
+
+    // Arrays can't be empty.
+    std::string tables = std::format("inline constexpr uint32_t {}_code[] = {{{}\n}};\n", name, code);
+    if (!strings_.empty()) {
+        tables += std::format("inline constexpr std::string_view {}_strings[] = {{{}\n}};\n", name, strings);
+    }
+    if (!numbers_.empty()) {
+        tables += std::format("inline constexpr double {}_numbers[] = {{{}\n}};\n", name, numbers);
+    }
+
+    return std::format(
+        "// Generated by cpplox_embed from {}. Do not edit.\n"
+        "#pragma once\n"
+        "\n"
+        "#include <image/image.h>\n"
+        "\n"
+        "static_assert(cpplox::ProgramImage::version == {}, \"{} was generated by another version of cpplox_embed\");\n"
+        "\n"
+        "namespace embedded {{\n"
+        "\n"
+        "{}\n"
+        "inline constexpr cpplox::ProgramImage {}{{ {}_code, {}, {} }};\n"
+        "\n"
+        "}}\n",
+        source, ProgramImage::version, name, tables, name, name,
+        strings_.empty() ? "{}" : name + "_strings", numbers_.empty() ? "{}" : name + "_numbers");
+}
+
+void ImageWriter::write(const Expr& expr) {
+    write(expr.index());
+    std::visit(*this, expr);
+}
+
+void ImageWriter::write(const Statement& stmt) {
+    write(stmt.index());
+    std::visit(*this, stmt);
+}
+
+void ImageWriter::write(uint32_t word) {
+    code_.push_back(word);
+}
+
+void ImageWriter::write(const Token& token) {
+    write(static_cast<uint32_t>(token.type()));
+    write(token.lexeme());
+    write(token.line());
+}
+
+void ImageWriter::write(const std::string& string) {
+    auto [it, inserted] = stringIndices_.try_emplace(string, strings_.size());
+    if (inserted) {
+        strings_.push_back(string);
+    }
+    write(it->second);
+}
+
+void ImageWriter::writeNumber(double number) {
+    write(numbers_.size());
+    numbers_.push_back(number);
+}
+
+void ImageWriter::writeDepth(const void* expr) {
+    auto depth = interpreter_.resolvedDepth(expr);
+    write(depth ? *depth + 1 : 0);
+}
+
+void ImageWriter::writeFunction(const FunctionStatement& stmt) {
+    write(stmt.name);
+    write(stmt.params.size());
+    for (const Token& param : stmt.params) {
+        write(param);
+    }
+    write(static_cast<uint32_t>(interpreter_.frameKind(stmt)));
+    writeCaptures(&stmt);
+    operator()(*stmt.body);
+}
+
+void ImageWriter::writeArguments(const std::vector<Expr>& arguments) {
+    write(arguments.size());
+    for (const Expr& argument : arguments) {
+        write(argument);
+    }
+}
+
+void ImageWriter::writeCaptures(const void* declaration) {
+    const auto& captures = interpreter_.captures(declaration);
+    write(captures.size());
+    for (const auto& [name, distance] : captures) {
+        write(name);
+        write(distance);
+    }
+}
+
+std::vector<Statement> ImageReader::read() {
+    // The version was checked when the image was compiled.
+    position_ = 1;
+    std::vector<Statement> stmts;
+    size_t count = word();
+    stmts.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        read(stmts.emplace_back(BlockStatement(std::vector<Statement>{})));
+    }
+    return stmts;
+}
+
+// Each node replaces the placeholder in `slot` and then reads its children
+// into placeholders of its own, so that it never moves once registered.
+void ImageReader::read(Expr& slot) {
+    switch (word()) {
+        case index_in_v<AssignExpr, Expr>: {
+            Token name = token();
+            auto distance = depth();
+            auto& expr = slot.emplace<AssignExpr>(std::move(name), LiteralExpr{});
+            if (distance) {
+                interpreter_.resolve(expr, *distance);
+            }
+            read(*expr.object);
+            return;
+        }
+        case index_in_v<BinaryExpr, Expr>: {
+            auto& expr = slot.emplace<BinaryExpr>(LiteralExpr{}, token(), LiteralExpr{});
+            read(*expr.left);
+            read(*expr.right);
+            return;
+        }
+        case index_in_v<CallExpr, Expr>: {
+            auto& expr = slot.emplace<CallExpr>(LiteralExpr{}, token(), std::vector<Expr>{});
+            read(*expr.callee);
+            readArguments(expr.arguments);
+            return;
+        }
+        case index_in_v<GetExpr, Expr>: {
+            auto& expr = slot.emplace<GetExpr>(LiteralExpr{}, token());
+            read(*expr.object);
+            return;
+        }
+        case index_in_v<GroupingExpr, Expr>: {
+            auto& expr = slot.emplace<GroupingExpr>(LiteralExpr{});
+            read(*expr.expr);
+            return;
+        }
+        case index_in_v<LiteralExpr, Expr>: {
+            switch (word()) {
+                case 0:
+                    slot = LiteralExpr{};
+                    return;
+                case 1:
+                    slot = LiteralExpr{ image_.numbers[word()] };
+                    return;
+                default:
+                    slot = LiteralExpr{ string() };
+                    return;
+            }
+        }
+        case index_in_v<LogicalExpr, Expr>: {
+            auto& expr = slot.emplace<LogicalExpr>(LiteralExpr{}, token(), LiteralExpr{});
+            read(*expr.left);
+            read(*expr.right);
+            return;
+        }
+        case index_in_v<SetExpr, Expr>: {
+            auto& expr = slot.emplace<SetExpr>(LiteralExpr{}, token(), LiteralExpr{});
+            read(*expr.object);
+            read(*expr.value);
+            return;
+        }
+        case index_in_v<SuperExpr, Expr>: {
+            Token keyword = token();
+            Token method = token();
+            auto& expr = slot.emplace<SuperExpr>(std::move(keyword), std::move(method));
+            if (auto distance = depth()) {
+                interpreter_.resolve(expr, *distance);
+            }
+            if (auto distance = depth()) {
+                interpreter_.resolveThis(expr, *distance);
+            }
+            return;
+        }
+        case index_in_v<ThisExpr, Expr>: {
+            auto& expr = slot.emplace<ThisExpr>(token());
+            if (auto distance = depth()) {
+                interpreter_.resolve(expr, *distance);
+            }
+            return;
+        }
+        case index_in_v<UnaryExpr, Expr>: {
+            auto& expr = slot.emplace<UnaryExpr>(token(), LiteralExpr{});
+            read(*expr.right);
+            return;
+        }
+        case index_in_v<VarExpr, Expr>: {
+            auto& expr = slot.emplace<VarExpr>(token());
+            if (auto distance = depth()) {
+                interpreter_.resolve(expr, *distance);
+            }
+            return;
+        }
+        case index_in_v<LocalCompareExpr, Expr>: {
+            std::string left = string();
+            size_t leftDepth = word();
+            auto op = static_cast<TokenType>(word());
+            std::string right = string();
+            size_t rightDepth = word();
+            slot.emplace<LocalCompareExpr>(std::move(left), leftDepth, op, std::move(right), rightDepth, word());
+            return;
+        }
+        case index_in_v<LocalIncrementExpr, Expr>: {
+            std::string name = string();
+            size_t depth = word();
+            auto op = static_cast<TokenType>(word());
+            double step = image_.numbers[word()];
+            slot.emplace<LocalIncrementExpr>(std::move(name), depth, op, step, word());
+            return;
+        }
+        case index_in_v<ThisGetExpr, Expr>: {
+            size_t depth = word();
+            std::string name = string();
+            slot.emplace<ThisGetExpr>(depth, std::move(name), word());
+            return;
+        }
+        case index_in_v<InvokeExpr, Expr>: {
+            Token name = token();
+            Token paren = token();
+            auto& expr = slot.emplace<InvokeExpr>(std::make_unique<Expr>(LiteralExpr{}), std::move(name), std::move(paren), std::vector<Expr>{});
+            read(*expr.object);
+            readArguments(expr.arguments);
+            return;
+        }
+        default:
+            // Unreachable.
+            break;
+    }
+    std::unreachable();
+}
+
+void ImageReader::read(Statement& slot) {
+    switch (word()) {
+        case index_in_v<BlockStatement, Statement>:
+            readBlock(slot.emplace<BlockStatement>(std::vector<Statement>{}));
+            return;
+        case index_in_v<ClassStatement, Statement>: {
+            auto& stmt = slot.emplace<ClassStatement>(token(), std::vector<FunctionStatement>{}, std::nullopt);
+            if (word()) {
+                auto& superclass = stmt.superclass.emplace(token());
+                if (auto distance = depth()) {
+                    interpreter_.resolve(superclass, *distance);
+                }
+            }
+            if (auto captured = captures(); !captured.empty()) {
+                interpreter_.resolve(stmt, std::move(captured));
+            }
+            size_t count = word();
+            stmt.methods.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                Token name = token();
+                std::vector<Token> parameters = params();
+                readFunction(stmt.methods.emplace_back(std::move(name), std::move(parameters), BlockStatement(std::vector<Statement>{})));
+            }
+            // Follows from the methods, so the image doesn't record it
+            interpreter_.resolveConstructor(stmt);
+            return;
+        }
+        case index_in_v<ExprStatement, Statement>:
+            read(slot.emplace<ExprStatement>(LiteralExpr{}).expr);
+            return;
+        case index_in_v<FunctionStatement, Statement>: {
+            Token name = token();
+            std::vector<Token> parameters = params();
+            readFunction(slot.emplace<FunctionStatement>(std::move(name), std::move(parameters), BlockStatement(std::vector<Statement>{})));
+            return;
+        }
+        case index_in_v<IfStatement, Statement>: {
+            if (word()) {
+                auto& stmt = slot.emplace<IfStatement>(LiteralExpr{}, BlockStatement(std::vector<Statement>{}), BlockStatement(std::vector<Statement>{}));
+                read(stmt.condition);
+                read(*stmt.thenBranch);
+                read(*stmt.elseBranch);
+                return;
+            }
+            auto& stmt = slot.emplace<IfStatement>(LiteralExpr{}, BlockStatement(std::vector<Statement>{}));
+            read(stmt.condition);
+            read(*stmt.thenBranch);
+            return;
+        }
+        case index_in_v<PrintStatement, Statement>:
+            read(slot.emplace<PrintStatement>(LiteralExpr{}).expr);
+            return;
+        case index_in_v<ReturnStatement, Statement>: {
+            Token keyword = token();
+            if (word()) {
+                read(*slot.emplace<ReturnStatement>(std::move(keyword), LiteralExpr{}).value);
+                return;
+            }
+            slot.emplace<ReturnStatement>(std::move(keyword), std::nullopt);
+            return;
+        }
+        case index_in_v<VarStatement, Statement>: {
+            Token name = token();
+            if (word()) {
+                read(*slot.emplace<VarStatement>(std::move(name), LiteralExpr{}).initializer);
+                return;
+            }
+            slot.emplace<VarStatement>(std::move(name));
+            return;
+        }
+        case index_in_v<WhileStatement, Statement>: {
+            auto& stmt = slot.emplace<WhileStatement>(LiteralExpr{}, BlockStatement(std::vector<Statement>{}));
+            read(stmt.condition);
+            readBlock(*stmt.body);
+            return;
+        }
+        default:
+            // Unreachable.
+            break;
+    }
+    std::unreachable();
+}
+
+void ImageReader::readBlock(BlockStatement& block) {
+    interpreter_.resolve(block, static_cast<BlockScope>(word()));
+    size_t count = word();
+    block.statements.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        read(block.statements.emplace_back(BlockStatement(std::vector<Statement>{})));
+    }
+}
+
+// What follows the name and parameters
+void ImageReader::readFunction(FunctionStatement& function) {
+    interpreter_.resolve(function, static_cast<FrameKind>(word()));
+    if (auto captured = captures(); !captured.empty()) {
+        interpreter_.resolve(function, std::move(captured));
+    }
+    readBlock(*function.body);
+}
+
+void ImageReader::readArguments(std::vector<Expr>& arguments) {
+    size_t count = word();
+    arguments.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        read(arguments.emplace_back(LiteralExpr{}));
+    }
+}
+
+std::vector<Capture> ImageReader::captures() {
+    std::vector<Capture> captures(word());
+    for (auto& [name, distance] : captures) {
+        name = string();
+        distance = word();
+    }
+    return captures;
+}
+
+uint32_t ImageReader::word() {
+    return image_.code[position_++];
+}
+
+Token ImageReader::token() {
+    auto type = static_cast<TokenType>(word());
+    std::string lexeme = string();
+    int line = word();
+    return Token(type, std::move(lexeme), std::nullopt, line);
+}
+
+std::vector<Token> ImageReader::params() {
+    std::vector<Token> params;
+    size_t count = word();
+    params.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        params.push_back(token());
+    }
+    return params;
+}
+
+std::string ImageReader::string() {
+    return std::string(image_.strings[word()]);
+}
+
+std::optional<size_t> ImageReader::depth() {
+    if (uint32_t depth = word()) {
+        return depth - 1;
+    }
+    return std::nullopt;
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// A resolved and optimized program flattened into constant tables, as
+// cpplox_embed emits them at build time. The AST owns heap memory, so it
+// can't itself be a constant; loading an image rebuilds it together with the
+// resolver's side tables in a single pass, without scanning, parsing or
+// resolving anything.
+//
+// `code` holds the nodes in pre-order, each as its index in Expr or
+// Statement followed by its fields. Tokens are a type, a string and a line;
+// scope distances are stored plus one, with zero for globals.
+struct ProgramImage {
+    // Bumped whenever the encoding changes. Generated headers check it, so
+    // a stale one fails to compile instead of loading garbage.
+    static constexpr uint32_t version = 1;
+
+    std::span<const uint32_t> code;
+    std::span<const std::string_view> strings;
+    std::span<const double> numbers;
+};
+
+// Flattens a program resolved against `interpreter` into an image
+class ImageWriter {
+public:
+    ImageWriter(const Interpreter& interpreter) : interpreter_(interpreter) {}
+
+    void operator()(const AssignExpr& expr);
+    void operator()(const BinaryExpr& expr);
+    void operator()(const CallExpr& expr);
+    void operator()(const GetExpr& expr);
+    void operator()(const GroupingExpr& expr);
+    void operator()(const LiteralExpr& expr);
+    void operator()(const LogicalExpr& expr);
+    void operator()(const SetExpr& expr);
+    void operator()(const SuperExpr& expr);
+    void operator()(const ThisExpr& expr);
+    void operator()(const UnaryExpr& expr);
+    void operator()(const VarExpr& expr);
+    void operator()(const LocalCompareExpr& expr);
+    void operator()(const LocalIncrementExpr& expr);
+    void operator()(const ThisGetExpr& expr);
+    void operator()(const InvokeExpr& expr);
+
+    void operator()(const BlockStatement& stmt);
+    void operator()(const ClassStatement& stmt);
+    void operator()(const ExprStatement& stmt);
+    void operator()(const FunctionStatement& stmt);
+    void operator()(const IfStatement& stmt);
+    void operator()(const PrintStatement& stmt);
+    void operator()(const ReturnStatement& stmt);
+    void operator()(const VarStatement& stmt);
+    void operator()(const WhileStatement& stmt);
+
+    void write(const std::vector<Statement>& stmts);
+
+    // The tables written so far, valid while the writer is alive
+    ProgramImage image();
+    // A header defining them as `name`, in namespace embedded
+    std::string header(const std::string& name, const std::string& source) const;
+
+private:
+    void write(const Expr& expr);
+    void write(const Statement& stmt);
+    void write(uint32_t word);
+    void write(const Token& token);
+    void write(const std::string& string);
+    void writeNumber(double number);
+    void writeDepth(const void* expr);
+    void writeFunction(const FunctionStatement& stmt);
+    void writeArguments(const std::vector<Expr>& arguments);
+    void writeCaptures(const void* declaration);
+
+    const Interpreter& interpreter_;
+    std::vector<uint32_t> code_{ ProgramImage::version };
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint32_t> stringIndices_;
+    std::vector<double> numbers_;
+    std::vector<std::string_view> views_;
+};
+
+// Rebuilds a program from its image, registering what the resolver decided
+// with `interpreter`. Nodes are constructed where they end up, since the
+// interpreter's tables are keyed by their addresses.
+class ImageReader {
+public:
+    ImageReader(const ProgramImage& image, Interpreter& interpreter) : image_(image), interpreter_(interpreter) {}
+
+    std::vector<Statement> read();
+
+private:
+    void read(Expr& slot);
+    void read(Statement& slot);
+    void readBlock(BlockStatement& block);
+    void readFunction(FunctionStatement& function);
+    void readArguments(std::vector<Expr>& arguments);
+    std::vector<Capture> captures();
+    uint32_t word();
+    Token token();
+    std::vector<Token> params();
+    std::string string();
+    std::optional<size_t> depth();
+
+    ProgramImage image_;
+    Interpreter& interpreter_;
+    size_t position_ = 0;
+};
+
+} // cpplox
\ No newline at end of file
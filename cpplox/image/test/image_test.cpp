@@ -0,0 +1,57 @@
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include <driver/driver.h>
+#include <env/interpreter.h>
+#include <env/optimizer.h>
+#include <env/resolver.h>
+#include <image/image.h>
+#include <parser/parser.h>
+#include <scanner/scanner.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include <class_lox.h>
+
+using namespace cpplox;
+
+TEST_CASE("ImageRoundTrip") {
+    Engine engine = GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered);
+    for (const auto& entry : std::filesystem::directory_iterator(SAMPLE_DIR)) {
+        INFO(entry.path().filename().string());
+        std::stringstream expected;
+        InterpreterDriver(expected, engine).runScript(entry.path());
+
+        // As cpplox_embed builds it
+        std::ifstream file(entry.path());
+        Diagnostic d;
+        std::string program{ std::istreambuf_iterator<char>(file), {} };
+        Scanner scanner(program, d);
+        auto tokens = scanner.scanTokens();
+        Parser parser(tokens, d);
+        auto stmts = parser.parse();
+        REQUIRE(stmts.has_value());
+        Interpreter interpreter(d);
+        Resolver resolver(interpreter);
+        resolver.resolve(*stmts);
+        Optimizer(interpreter).optimize(*stmts);
+        ImageWriter writer(interpreter);
+        writer.write(*stmts);
+
+        std::stringstream out;
+        InterpreterDriver(out, engine).runImage(writer.image());
+        CHECK(out.str() == expected.str());
+    }
+}
+
+TEST_CASE("EmbeddedScript") {
+    static_assert(embedded::class_lox.code[0] == ProgramImage::version);
+    std::stringstream ss;
+    InterpreterDriver driver(ss, GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered));
+    driver.runImage(embedded::class_lox);
+    REQUIRE(ss.str() == "<class MyClass>\n\"0\"\n\"1\"\n\"hello\"\n<instance of <class MyClass>>\n");
+}
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include <jit/assembler.h>
+
+#include <bit>
+#include <cstring>
+
+namespace cpplox {
+
+void Assembler::prologue() {
+    emit({ 0x55 });                   // push rbp
+    emit({ 0x48, 0x89, 0xE5 });       // mov rbp, rsp
+    emit({ 0x53 });                   // push rbx
+    emit({ 0x48, 0x81, 0xEC });       // sub rsp, imm32
+    frameSizeAt_ = code_.size();
+    emit32(0);
+    emit({ 0x48, 0x89, 0xFB });       // mov rbx, rdi
+}
+
+void Assembler::setFrameSize(int32_t bytes) {
+    std::memcpy(code_.data() + frameSizeAt_, &bytes, sizeof(bytes));
+}
+
+void Assembler::epilogue() {
+    emit({ 0x48, 0x8D, 0x65, 0xF8 }); // lea rsp, [rbp - 8]
+    emit({ 0x5B });                   // pop rbx
+    emit({ 0x5D });                   // pop rbp
+    emit({ 0xC3 });                   // ret
+}
+
+void Assembler::loadArgument(Xmm dst, int32_t index) {
+    emit({ 0xF2, 0x0F, 0x10, static_cast<uint8_t>(0x86 | (static_cast<uint8_t>(dst) << 3)) });
+    emit32(8 * index);
+}
+
+void Assembler::load(Xmm dst, int32_t offset) {
+    emit({ 0xF2, 0x0F, 0x10 });
+    emitRbpOperand(static_cast<uint8_t>(dst), offset);
+}
+
+void Assembler::store(int32_t offset, Xmm src) {
+    emit({ 0xF2, 0x0F, 0x11 });
+    emitRbpOperand(static_cast<uint8_t>(src), offset);
+}
+
+void Assembler::loadConstant(Xmm dst, double value) {
+    emit({ 0x48, 0xB8 });             // mov rax, imm64
+    emit64(std::bit_cast<uint64_t>(value));
+    emit({ 0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (static_cast<uint8_t>(dst) << 3)) });
+}
+
+void Assembler::moveToXmm1() {
+    emit({ 0x66, 0x0F, 0x28, 0xC8 });
+}
+
+void Assembler::add() {
+    emit({ 0xF2, 0x0F, 0x58, 0xC1 });
+}
+
+void Assembler::sub() {
+    emit({ 0xF2, 0x0F, 0x5C, 0xC1 });
+}
+
+void Assembler::mul() {
+    emit({ 0xF2, 0x0F, 0x59, 0xC1 });
+}
+
+void Assembler::div() {
+    emit({ 0xF2, 0x0F, 0x5E, 0xC1 });
+}
+
+void Assembler::negate() {
+    emit({ 0x66, 0x48, 0x0F, 0x7E, 0xC0 }); // movq rax, xmm0
+    emit({ 0x48, 0x0F, 0xBA, 0xF8, 0x3F }); // btc rax, 63
+    emit({ 0x66, 0x48, 0x0F, 0x6E, 0xC0 }); // movq xmm0, rax
+}
+
+void Assembler::compare(Xmm left, Xmm right) {
+    emit({ 0x66, 0x0F, 0x2E, static_cast<uint8_t>(0xC0 | (static_cast<uint8_t>(left) << 3) | static_cast<uint8_t>(right)) });
+}
+
+void Assembler::zero() {
+    emit({ 0x66, 0x0F, 0x57, 0xC0 });
+}
+
+void Assembler::saveTable(int32_t offset) {
+    emit({ 0x48, 0x89, 0xB5 });
+    emit32(offset);
+}
+
+void Assembler::loadPointer(int32_t table, int32_t index) {
+    emit({ 0x48, 0x8B, 0x85 });
+    emit32(table);
+    emit({ 0x48, 0x8B, 0x80 });
+    emit32(8 * index);
+}
+
+void Assembler::loadIndirect(Xmm dst) {
+    emit({ 0xF2, 0x0F, 0x10, static_cast<uint8_t>(static_cast<uint8_t>(dst) << 3) });
+}
+
+void Assembler::storeIndirect(Xmm src) {
+    emit({ 0xF2, 0x0F, 0x11, static_cast<uint8_t>(static_cast<uint8_t>(src) << 3) });
+}
+
+void Assembler::callRuntime(const void* target, const void* argument, int32_t offset) {
+    emit({ 0x48, 0x89, 0xDF });       // mov rdi, rbx
+    emit({ 0x48, 0xBE });             // mov rsi, imm64
+    emit64(reinterpret_cast<uint64_t>(argument));
+    emit({ 0x48, 0x8D, 0x95 });       // lea rdx, [rbp + disp32]
+    emit32(offset);
+    emit({ 0x48, 0xB8 });             // mov rax, imm64
+    emit64(reinterpret_cast<uint64_t>(target));
+    emit({ 0xFF, 0xD0 });             // call rax
+}
+
+void Assembler::testFlag(int8_t offset) {
+    emit({ 0x80, 0x7B, static_cast<uint8_t>(offset), 0x00 });
+}
+
+void Assembler::setFlag(int8_t offset) {
+    emit({ 0xC6, 0x43, static_cast<uint8_t>(offset), 0x01 });
+}
+
+void Assembler::jump(Label& label) {
+    emit({ 0xE9 });
+    emitLabel(label);
+}
+
+void Assembler::jump(Condition condition, Label& label) {
+    emit({ 0x0F, static_cast<uint8_t>(condition) });
+    emitLabel(label);
+}
+
+void Assembler::bind(Label& label) {
+    label.position = code_.size();
+    for (int fixup : label.fixups) {
+        int32_t relative = label.position - (fixup + 4);
+        std::memcpy(code_.data() + fixup, &relative, sizeof(relative));
+    }
+    label.fixups.clear();
+}
+
+void Assembler::emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+}
+
+void Assembler::emit32(int32_t value) {
+    uint8_t bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    code_.insert(code_.end(), std::begin(bytes), std::end(bytes));
+}
+
+void Assembler::emit64(uint64_t value) {
+    uint8_t bytes[sizeof(value)];
+    std::memcpy(bytes, &value, sizeof(value));
+    code_.insert(code_.end(), std::begin(bytes), std::end(bytes));
+}
+
+// ModRM for [rbp + disp32]
+void Assembler::emitRbpOperand(uint8_t reg, int32_t offset) {
+    emit({ static_cast<uint8_t>(0x85 | (reg << 3)) });
+    emit32(offset);
+}
+
+// rel32 to the label, patched when the label is bound later
+void Assembler::emitLabel(Label& label) {
+    int at = code_.size();
+    if (label.position >= 0) {
+        emit32(label.position - (at + 4));
+        return;
+    }
+    label.fixups.push_back(at);
+    emit32(0);
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace cpplox {
+
+// Just enough of an x86-64 encoder for the baseline JIT. Doubles live in
+// xmm0 and xmm1, frame slots are addressed off rbp and the JitContext is
+// kept in rbx.
+class Assembler {
+public:
+    enum class Xmm : uint8_t { xmm0 = 0, xmm1 = 1 };
+
+    // Conditions of jcc, as the second opcode byte
+    enum class Condition : uint8_t {
+        Below = 0x82,
+        AboveEqual = 0x83,
+        Equal = 0x84,
+        NotEqual = 0x85,
+        BelowEqual = 0x86,
+        Above = 0x87,
+        Parity = 0x8A,
+        NoParity = 0x8B,
+    };
+
+    // A jump target, bound once its position is known
+    struct Label {
+        int position = -1;
+        std::vector<int> fixups;
+    };
+
+    // push rbp; mov rbp, rsp; push rbx; sub rsp, <frame size>; mov rbx, rdi.
+    // The frame size is patched in by setFrameSize().
+    void prologue();
+    void setFrameSize(int32_t bytes);
+    // lea rsp, [rbp - 8]; pop rbx; pop rbp; ret
+    void epilogue();
+
+    void loadArgument(Xmm dst, int32_t index);            // movsd dst, [rsi + 8 * index]
+    void load(Xmm dst, int32_t offset);                   // movsd dst, [rbp + offset]
+    void store(int32_t offset, Xmm src);                  // movsd [rbp + offset], src
+    void loadConstant(Xmm dst, double value);             // mov rax, imm64; movq dst, rax
+    void moveToXmm1();                                    // movapd xmm1, xmm0
+    void add();                                           // addsd xmm0, xmm1
+    void sub();                                           // subsd xmm0, xmm1
+    void mul();                                           // mulsd xmm0, xmm1
+    void div();                                           // divsd xmm0, xmm1
+    void negate();                                        // flips the sign bit of xmm0
+    void compare(Xmm left, Xmm right);                    // ucomisd left, right
+    void zero();                                          // xorpd xmm0, xmm0
+
+    // Indirect access through a table of pointers, as loop traces reach the
+    // variables of the environment they run in
+    void saveTable(int32_t offset);                       // mov [rbp + offset], rsi
+    void loadPointer(int32_t table, int32_t index);       // mov rax, [rbp + table]; mov rax, [rax + 8 * index]
+    void loadIndirect(Xmm dst);                           // movsd dst, [rax]
+    void storeIndirect(Xmm src);                          // movsd [rax], src
+
+    // Calls target(rbx, argument, rbp + offset), leaving its result in xmm0
+    void callRuntime(const void* target, const void* argument, int32_t offset);
+    // cmp byte [rbx + offset], 0
+    void testFlag(int8_t offset);
+    // mov byte [rbx + offset], 1
+    void setFlag(int8_t offset);
+
+    void jump(Label& label);
+    void jump(Condition condition, Label& label);
+    void bind(Label& label);
+
+    const std::vector<uint8_t>& code() const {
+        return code_;
+    }
+
+private:
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emit32(int32_t value);
+    void emit64(uint64_t value);
+    void emitRbpOperand(uint8_t reg, int32_t offset);
+    void emitLabel(Label& label);
+
+    std::vector<uint8_t> code_;
+    int frameSizeAt_ = -1;
+};
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,854 @@
+#include <jit/jit.h>
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <variant>
+
+#ifdef CPPLOX_JIT_X64
+#include <sys/mman.h>
+#endif
+
+#include <env/interpreter.h>
+#include <env/number.h>
+#include <env/object.h>
+#include <jit/assembler.h>
+#include <util/scope_guard.h>
+
+namespace {
+
+using namespace cpplox;
+
+using Xmm = Assembler::Xmm;
+using Condition = Assembler::Condition;
+using Label = Assembler::Label;
+
+// Lox allows at most 255 arguments
+constexpr size_t maxArguments = 255;
+// Variables from outside the loop a trace can hold
+constexpr size_t maxVariables = 32;
+
+// Translates one function body or loop trace into machine code, one template
+// per node. Every local gets a frame slot holding its unboxed double;
+// expressions leave their value in xmm0. Returns false on anything outside
+// the numeric subset.
+class CodeGenerator {
+public:
+    CodeGenerator(Jit::Code& code, const void* call, const void* load) : code_(code), call_(call), load_(load) {}
+
+    bool generate(const FunctionStatement& declaration) {
+        if (declaration.params.size() > maxArguments) {
+            return false;
+        }
+        assembler_.prologue();
+        scopes_.emplace_back();
+        for (size_t i = 0; i < declaration.params.size(); i++) {
+            int32_t slot = declare(declaration.params[i].lexeme()).slot;
+            assembler_.loadArgument(Xmm::xmm0, i);
+            assembler_.store(slot, Xmm::xmm0);
+        }
+        if (!block(*declaration.body)) {
+            return false;
+        }
+        // Falling off the end returns nil.
+        assembler_.jump(deopt_);
+
+        assembler_.bind(deopt_);
+        assembler_.setFlag(offsetof(JitContext, deopt));
+        assembler_.zero();
+        assembler_.bind(return_);
+        assembler_.epilogue();
+        setFrameSize();
+        return true;
+    }
+
+    // Compiles the recorded path through a loop, returning 0 once its
+    // condition fails and 1 on a side exit. Variables from outside the loop
+    // are resolved by their distance, as the interpreter would, and loaded
+    // into slots on entry; only those the trace assigns are written through
+    // and rolled back.
+    bool generate(const WhileStatement& loop, const Interpreter& interpreter, const Jit::Path& path) {
+        interpreter_ = &interpreter;
+        path_ = &path;
+        assembler_.prologue();
+        table_ = allocate(1);
+        allocate(maxVariables);
+        assembler_.saveTable(table_);
+
+        // Which variables to load and save is only known at the end.
+        Label load, loaded, save, saved, finished;
+        assembler_.jump(load);
+        assembler_.bind(loaded);
+        Label top;
+        assembler_.bind(top);
+        assembler_.jump(save);
+        assembler_.bind(saved);
+        if (!branch(loop.condition, false, finished) || !block(*loop.body)) {
+            return false;
+        }
+        assembler_.jump(top);
+
+        assembler_.bind(finished);
+        assembler_.zero();
+        assembler_.jump(return_);
+
+        slots_ = maxSlots_;
+        int32_t backup = allocate(variables_.size());
+        assembler_.bind(deopt_);
+        for (size_t i = 0; i < variables_.size(); i++) {
+            if (variables_[i].written) {
+                assembler_.load(Xmm::xmm0, backup + 8 * i);
+                assembler_.loadPointer(table_, i);
+                assembler_.storeIndirect(Xmm::xmm0);
+            }
+        }
+        assembler_.loadConstant(Xmm::xmm0, 1);
+        assembler_.bind(return_);
+        assembler_.epilogue();
+
+        assembler_.bind(load);
+        for (size_t i = 0; i < variables_.size(); i++) {
+            assembler_.loadPointer(table_, i);
+            assembler_.loadIndirect(Xmm::xmm0);
+            assembler_.store(variableSlot(i), Xmm::xmm0);
+        }
+        assembler_.jump(loaded);
+
+        assembler_.bind(save);
+        for (size_t i = 0; i < variables_.size(); i++) {
+            if (variables_[i].written) {
+                assembler_.load(Xmm::xmm0, variableSlot(i));
+                assembler_.store(backup + 8 * i, Xmm::xmm0);
+            }
+        }
+        assembler_.jump(saved);
+        setFrameSize();
+        return true;
+    }
+
+    const std::vector<uint8_t>& code() const {
+        return assembler_.code();
+    }
+
+    std::vector<Jit::TraceVariable> variables() const {
+        std::vector<Jit::TraceVariable> variables;
+        for (const auto& variable : variables_) {
+            variables.push_back({ variable.distance, variable.name });
+        }
+        return variables;
+    }
+
+    bool operator()(const AssignExpr& expr) {
+        return value(*expr.object) && store(expr.name.lexeme(), interpreter_ ? interpreter_->resolvedDepth(&expr) : std::nullopt);
+    }
+
+    bool operator()(const BinaryExpr& expr) {
+        switch (expr.op.type()) {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::STAR:
+            case TokenType::SLASH:
+                break;
+            default:
+                // Comparisons only as conditions
+                return false;
+        }
+        if (!operands(*expr.left, *expr.right)) {
+            return false;
+        }
+        switch (expr.op.type()) {
+            case TokenType::PLUS:
+                assembler_.add();
+                break;
+            case TokenType::MINUS:
+                assembler_.sub();
+                break;
+            case TokenType::STAR:
+                assembler_.mul();
+                break;
+            default:
+                assembler_.div();
+                break;
+        }
+        return true;
+    }
+
+    bool operator()(const CallExpr& expr) {
+        auto* callee = std::get_if<VarExpr>(expr.callee.get());
+        if (!callee || lookUp(callee->name.lexeme()) || expr.arguments.size() > maxArguments) {
+            return false;
+        }
+        // The arguments go to consecutive slots, first one lowest.
+        size_t count = expr.arguments.size();
+        int32_t base = allocate(count);
+        for (size_t i = 0; i < count; i++) {
+            if (!value(expr.arguments[i])) {
+                return false;
+            }
+            assembler_.store(base + 8 * i, Xmm::xmm0);
+        }
+        auto& site = code_.callSites.emplace_back(std::make_unique<Jit::CallSite>(callee->name.lexeme(), count));
+        assembler_.callRuntime(call_, site.get(), count > 0 ? base : 0);
+        release(count);
+        checkDeopt();
+        return true;
+    }
+
+    bool operator()(const GroupingExpr& expr) {
+        return value(*expr.expr);
+    }
+
+    bool operator()(const LiteralExpr& expr) {
+        if (!expr.object.has_value() || !std::holds_alternative<double>(*expr.object)) {
+            return false;
+        }
+        assembler_.loadConstant(Xmm::xmm0, std::get<double>(*expr.object));
+        return true;
+    }
+
+    bool operator()(const UnaryExpr& expr) {
+        if (expr.op.type() != TokenType::MINUS || !value(*expr.right)) {
+            return false;
+        }
+        assembler_.negate();
+        return true;
+    }
+
+    bool operator()(const VarExpr& expr) {
+        return load(expr.name.lexeme(), interpreter_ ? interpreter_->resolvedDepth(&expr) : std::nullopt);
+    }
+
+    bool operator()(const LocalIncrementExpr& expr) {
+        if (!lookUp(expr.name) && !interpreter_) {
+            return false;
+        }
+        if (!load(expr.name, expr.depth)) {
+            return false;
+        }
+        assembler_.loadConstant(Xmm::xmm1, expr.step);
+        expr.op == TokenType::PLUS ? assembler_.add() : assembler_.sub();
+        return store(expr.name, expr.depth);
+    }
+
+    // Anything else produces or needs values other than numbers.
+    template <typename T>
+    bool operator()(const T&) {
+        return false;
+    }
+
+private:
+    bool value(const Expr& expr) {
+        if (auto folded = constant(expr)) {
+            assembler_.loadConstant(Xmm::xmm0, *folded);
+            return true;
+        }
+        return std::visit(*this, expr);
+    }
+
+    // Value of an arithmetic expression over literals and locals known to
+    // be constant
+    std::optional<double> constant(const Expr& expr) {
+        if (auto* literal = std::get_if<LiteralExpr>(&expr)) {
+            if (literal->object.has_value() && std::holds_alternative<double>(*literal->object)) {
+                return std::get<double>(*literal->object);
+            }
+            return std::nullopt;
+        }
+        if (auto* var = std::get_if<VarExpr>(&expr)) {
+            auto* local = lookUp(var->name.lexeme());
+            return local ? local->constant : std::nullopt;
+        }
+        if (auto* grouping = std::get_if<GroupingExpr>(&expr)) {
+            return constant(*grouping->expr);
+        }
+        if (auto* unary = std::get_if<UnaryExpr>(&expr); unary && unary->op.type() == TokenType::MINUS) {
+            auto right = constant(*unary->right);
+            return right ? std::optional(-*right) : std::nullopt;
+        }
+        auto* binary = std::get_if<BinaryExpr>(&expr);
+        if (!binary) {
+            return std::nullopt;
+        }
+        auto left = constant(*binary->left);
+        auto right = left ? constant(*binary->right) : std::nullopt;
+        if (!right) {
+            return std::nullopt;
+        }
+        switch (binary->op.type()) {
+            case TokenType::PLUS:
+                return *left + *right;
+            case TokenType::MINUS:
+                return *left - *right;
+            case TokenType::STAR:
+                return *left * *right;
+            case TokenType::SLASH:
+                return *left / *right;
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // Jumps to `target` if the truthiness of `expr` is `when`
+    bool branch(const Expr& expr, bool when, Label& target) {
+        if (auto* binary = std::get_if<BinaryExpr>(&expr); binary && isComparison(binary->op.type())) {
+            if (!operands(*binary->left, *binary->right)) {
+                return false;
+            }
+            compare(binary->op.type(), when, target);
+            return true;
+        }
+        if (auto* compare = std::get_if<LocalCompareExpr>(&expr)) {
+            if (!load(compare->left, compare->leftDepth)) {
+                return false;
+            }
+            int32_t slot = allocate(1);
+            assembler_.store(slot, Xmm::xmm0);
+            if (!load(compare->right, compare->rightDepth)) {
+                return false;
+            }
+            assembler_.moveToXmm1();
+            assembler_.load(Xmm::xmm0, slot);
+            release(1);
+            this->compare(compare->op, when, target);
+            return true;
+        }
+        if (auto* logical = std::get_if<LogicalExpr>(&expr)) {
+            // Short-circuits to `target` if the left operand decides
+            bool decides = logical->op.type() == TokenType::OR;
+            if (when == decides) {
+                return branch(*logical->left, when, target) && branch(*logical->right, when, target);
+            }
+            Label skip;
+            if (!branch(*logical->left, decides, skip) || !branch(*logical->right, when, target)) {
+                return false;
+            }
+            assembler_.bind(skip);
+            return true;
+        }
+        if (auto* unary = std::get_if<UnaryExpr>(&expr); unary && unary->op.type() == TokenType::BANG) {
+            return branch(*unary->right, !when, target);
+        }
+        if (auto* grouping = std::get_if<GroupingExpr>(&expr)) {
+            return branch(*grouping->expr, when, target);
+        }
+        // Numbers are always truthy.
+        if (!value(expr)) {
+            return false;
+        }
+        if (when) {
+            assembler_.jump(target);
+        }
+        return true;
+    }
+
+    static bool isComparison(TokenType op) {
+        switch (op) {
+            case TokenType::LESS:
+            case TokenType::LESS_EQUAL:
+            case TokenType::GREATER:
+            case TokenType::GREATER_EQUAL:
+            case TokenType::EQUAL_EQUAL:
+            case TokenType::BANG_EQUAL:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // Compares xmm0 with xmm1. ucomisd reports unordered operands (NaN) as
+    // below and equal, which must make every comparison but != false.
+    void compare(TokenType op, bool when, Label& target) {
+        switch (op) {
+            case TokenType::LESS:
+                assembler_.compare(Xmm::xmm1, Xmm::xmm0);
+                assembler_.jump(when ? Condition::Above : Condition::BelowEqual, target);
+                break;
+            case TokenType::LESS_EQUAL:
+                assembler_.compare(Xmm::xmm1, Xmm::xmm0);
+                assembler_.jump(when ? Condition::AboveEqual : Condition::Below, target);
+                break;
+            case TokenType::GREATER:
+                assembler_.compare(Xmm::xmm0, Xmm::xmm1);
+                assembler_.jump(when ? Condition::Above : Condition::BelowEqual, target);
+                break;
+            case TokenType::GREATER_EQUAL:
+                assembler_.compare(Xmm::xmm0, Xmm::xmm1);
+                assembler_.jump(when ? Condition::AboveEqual : Condition::Below, target);
+                break;
+            default: {
+                assembler_.compare(Xmm::xmm0, Xmm::xmm1);
+                bool equal = (op == TokenType::EQUAL_EQUAL) == when;
+                if (equal) {
+                    Label skip;
+                    assembler_.jump(Condition::Parity, skip);
+                    assembler_.jump(Condition::Equal, target);
+                    assembler_.bind(skip);
+                } else {
+                    assembler_.jump(Condition::Parity, target);
+                    assembler_.jump(Condition::NotEqual, target);
+                }
+                break;
+            }
+        }
+    }
+
+    // Leaves the left operand in xmm0 and the right one in xmm1
+    bool operands(const Expr& left, const Expr& right) {
+        if (!value(left)) {
+            return false;
+        }
+        int32_t slot = allocate(1);
+        assembler_.store(slot, Xmm::xmm0);
+        if (!value(right)) {
+            return false;
+        }
+        assembler_.moveToXmm1();
+        assembler_.load(Xmm::xmm0, slot);
+        release(1);
+        return true;
+    }
+
+    bool block(const BlockStatement& stmt) {
+        // Distances are counted in environments, which not every block has.
+        size_t level = level_;
+        if (interpreter_ && interpreter_->blockScope(stmt) != BlockScope::None) {
+            level_++;
+        }
+        scopes_.emplace_back();
+        for (const auto& s : stmt.statements) {
+            if (!statement(s)) {
+                return false;
+            }
+        }
+        release(scopes_.back().size());
+        scopes_.pop_back();
+        level_ = level;
+        return true;
+    }
+
+    bool statement(const Statement& stmt) {
+        if (auto* b = std::get_if<BlockStatement>(&stmt)) {
+            return block(*b);
+        }
+        if (auto* expr = std::get_if<ExprStatement>(&stmt)) {
+            return value(expr->expr);
+        }
+        if (auto* var = std::get_if<VarStatement>(&stmt)) {
+            if (!var->initializer.has_value() || !value(*var->initializer)) {
+                return false;
+            }
+            Local& local = declare(var->name.lexeme());
+            assembler_.store(local.slot, Xmm::xmm0);
+            // A trace runs straight through, so until the local is assigned
+            // it holds its initial value.
+            if (interpreter_) {
+                local.constant = constant(*var->initializer);
+            }
+            return true;
+        }
+        if (auto* ifStmt = std::get_if<IfStatement>(&stmt); ifStmt && path_) {
+            // Guards the recorded direction
+            auto taken = path_->find(ifStmt);
+            if (taken == path_->end() || !branch(ifStmt->condition, !taken->second, deopt_)) {
+                return false;
+            }
+            const Statement* next = taken->second ? ifStmt->thenBranch.get() : ifStmt->elseBranch.get();
+            return !next || statement(*next);
+        }
+        if (auto* ifStmt = std::get_if<IfStatement>(&stmt)) {
+            Label otherwise, end;
+            if (!branch(ifStmt->condition, false, otherwise) || !statement(*ifStmt->thenBranch)) {
+                return false;
+            }
+            assembler_.jump(end);
+            assembler_.bind(otherwise);
+            if (ifStmt->elseBranch && !statement(*ifStmt->elseBranch)) {
+                return false;
+            }
+            assembler_.bind(end);
+            return true;
+        }
+        // Traces cover innermost loops only, and can't return.
+        if (interpreter_) {
+            return false;
+        }
+        if (auto* whileStmt = std::get_if<WhileStatement>(&stmt)) {
+            Label top, end;
+            assembler_.bind(top);
+            if (!branch(whileStmt->condition, false, end) || !block(*whileStmt->body)) {
+                return false;
+            }
+            assembler_.jump(top);
+            assembler_.bind(end);
+            return true;
+        }
+        if (auto* ret = std::get_if<ReturnStatement>(&stmt)) {
+            // A bare return returns nil, which isn't a number.
+            if (!ret->value.has_value() || !value(*ret->value)) {
+                return false;
+            }
+            assembler_.jump(return_);
+            return true;
+        }
+        return false;
+    }
+
+    // Reads a variable into xmm0. `depth` is where the resolver found it,
+    // which traces need for variables from outside the loop.
+    bool load(const std::string& name, std::optional<size_t> depth) {
+        if (auto* local = lookUp(name)) {
+            if (local->constant) {
+                assembler_.loadConstant(Xmm::xmm0, *local->constant);
+            } else {
+                assembler_.load(Xmm::xmm0, local->slot);
+            }
+            return true;
+        }
+        if (interpreter_) {
+            auto index = variable(name, depth);
+            if (!index) {
+                return false;
+            }
+            assembler_.load(Xmm::xmm0, variableSlot(*index));
+            return true;
+        }
+        // Captured or global, read through the runtime
+        auto& stored = code_.names.emplace_back(std::make_unique<std::string>(name));
+        assembler_.callRuntime(load_, stored.get(), 0);
+        checkDeopt();
+        return true;
+    }
+
+    // Assigns xmm0 to a variable. Functions only assign their own locals.
+    bool store(const std::string& name, std::optional<size_t> depth) {
+        if (auto* local = lookUp(name)) {
+            local->constant.reset();
+            assembler_.store(local->slot, Xmm::xmm0);
+            return true;
+        }
+        auto index = interpreter_ ? variable(name, depth) : std::nullopt;
+        if (!index) {
+            return false;
+        }
+        variables_[*index].written = true;
+        assembler_.store(variableSlot(*index), Xmm::xmm0);
+        assembler_.loadPointer(table_, *index);
+        assembler_.storeIndirect(Xmm::xmm0);
+        return true;
+    }
+
+    // Index of a variable from outside the traced loop
+    std::optional<size_t> variable(const std::string& name, std::optional<size_t> depth) {
+        if (!depth || *depth < level_) {
+            return std::nullopt;
+        }
+        size_t distance = *depth - level_;
+        for (size_t i = 0; i < variables_.size(); i++) {
+            if (variables_[i].distance == distance && variables_[i].name == name) {
+                return i;
+            }
+        }
+        if (variables_.size() == maxVariables) {
+            return std::nullopt;
+        }
+        variables_.push_back({ distance, name });
+        return variables_.size() - 1;
+    }
+
+    int32_t variableSlot(size_t index) const {
+        return table_ - 8 - 8 * static_cast<int32_t>(index);
+    }
+
+    void checkDeopt() {
+        assembler_.testFlag(offsetof(JitContext, deopt));
+        assembler_.jump(Condition::NotEqual, deopt_);
+    }
+
+    struct Local {
+        int32_t slot;
+        // Value of a trace local that wasn't assigned since its declaration
+        std::optional<double> constant;
+    };
+
+    Local* lookUp(const std::string& name) {
+        for (auto scope = scopes_.rbegin(); scope != scopes_.rend(); ++scope) {
+            if (auto it = scope->find(name); it != scope->end()) {
+                return &it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    Local& declare(const std::string& name) {
+        int32_t slot = allocate(1);
+        return scopes_.back()[name] = Local{ slot, std::nullopt };
+    }
+
+    // Slots are handed out in stack order below the saved rbx. Returns the
+    // offset of the lowest of them.
+    int32_t allocate(size_t count) {
+        slots_ += count;
+        maxSlots_ = std::max(maxSlots_, slots_);
+        return -8 - 8 * static_cast<int32_t>(slots_);
+    }
+
+    void release(size_t count) {
+        slots_ -= count;
+    }
+
+    // rbx is pushed below rbp; keep rsp 16-byte aligned for calls.
+    void setFrameSize() {
+        int32_t frameSize = 8 * maxSlots_;
+        if (frameSize % 16 != 8) {
+            frameSize += 8;
+        }
+        assembler_.setFrameSize(frameSize);
+    }
+
+    Jit::Code& code_;
+    const void* call_;
+    const void* load_;
+    Assembler assembler_;
+    std::vector<std::unordered_map<std::string, Local>> scopes_;
+    size_t slots_ = 0;
+    size_t maxSlots_ = 0;
+    Label return_;
+    // Side exit of a trace
+    Label deopt_;
+
+    // Only set for traces
+    const Interpreter* interpreter_ = nullptr;
+    const Jit::Path* path_ = nullptr;
+    struct Variable {
+        size_t distance;
+        std::string name;
+        bool written = false;
+    };
+    std::vector<Variable> variables_;
+    // Slot of the pointer to the variables, followed by their own slots
+    int32_t table_ = 0;
+    // Environments entered since the start of the loop
+    size_t level_ = 0;
+};
+
+}
+
+namespace cpplox {
+
+MachineCode::MachineCode(const std::vector<uint8_t>& code) {
+#ifdef CPPLOX_JIT_X64
+    void* memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return;
+    }
+    std::memcpy(memory, code.data(), code.size());
+    if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, code.size());
+        return;
+    }
+    memory_ = memory;
+    size_ = code.size();
+    entry_ = reinterpret_cast<Entry>(memory);
+#endif
+}
+
+MachineCode::~MachineCode() {
+#ifdef CPPLOX_JIT_X64
+    if (memory_) {
+        munmap(memory_, size_);
+    }
+#endif
+}
+
+std::optional<Object> Jit::call(Function& function, const std::vector<Object>& arguments, size_t depth) {
+    if (depth == 0) {
+        return std::nullopt;
+    }
+    const MachineCode* code = function.machineCode_ ? function.machineCode_ : compile(function);
+    if (!code) {
+        function.jittable_ = false;
+        return std::nullopt;
+    }
+
+    // Machine code computes on doubles, which integers stand in for exactly
+    std::array<double, maxArguments> values;
+    for (size_t i = 0; i < arguments.size(); i++) {
+        if (!isNumber(arguments[i])) {
+            return std::nullopt;
+        }
+        values[i] = toDouble(arguments[i]);
+    }
+
+    JitContext context{ function.closure_.get(), &globals_, this, false, depth - 1 };
+    double result = (*code)(&context, values.data());
+    if (context.deopt) {
+        function.jittable_ = false;
+        stats_.deopts++;
+        return std::nullopt;
+    }
+    return number(result);
+}
+
+const MachineCode* Jit::compile(Function& function) {
+#ifdef CPPLOX_JIT_X64
+    if (function.isInit_) {
+        return nullptr;
+    }
+    auto [it, inserted] = code_.try_emplace(&function.declaration_);
+    if (inserted) {
+        auto code = std::make_unique<Code>();
+        CodeGenerator generator(*code, reinterpret_cast<const void*>(&Jit::callFromNative), reinterpret_cast<const void*>(&Jit::loadFromNative));
+        if (generator.generate(function.declaration_)) {
+            code->machineCode = std::make_unique<MachineCode>(generator.code());
+        }
+        if (code->machineCode && *code->machineCode) {
+            it->second = std::move(code);
+            stats_.compiled++;
+        } else {
+            stats_.rejected++;
+        }
+    }
+    function.machineCode_ = it->second ? it->second->machineCode.get() : nullptr;
+    return function.machineCode_;
+#else
+    return nullptr;
+#endif
+}
+
+Jit::Trace* Jit::trace(const WhileStatement& loop) {
+    auto it = traces_.find(&loop);
+    if (it == traces_.end() || !it->second || it->second->blacklisted) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+void Jit::compileTrace(const WhileStatement& loop, const Path& path, const Interpreter& interpreter) {
+    auto& trace = traces_[&loop];
+#ifdef CPPLOX_JIT_X64
+    auto compiled = std::make_unique<Trace>();
+    CodeGenerator generator(compiled->code, reinterpret_cast<const void*>(&Jit::callFromNative), reinterpret_cast<const void*>(&Jit::loadFromNative));
+    if (generator.generate(loop, interpreter, path)) {
+        compiled->code.machineCode = std::make_unique<MachineCode>(generator.code());
+        compiled->variables = generator.variables();
+        compiled->path = path;
+    }
+    if (compiled->code.machineCode && *compiled->code.machineCode) {
+        trace = std::move(compiled);
+        stats_.traces++;
+        return;
+    }
+#endif
+    stats_.rejectedTraces++;
+}
+
+const Jit::Path* Jit::tracePath(const WhileStatement& loop) const {
+    auto it = traces_.find(&loop);
+    if (it == traces_.end() || !it->second || it->second->blacklisted) {
+        return nullptr;
+    }
+    return &it->second->path;
+}
+
+std::optional<bool> Jit::compiled(const FunctionStatement& function) const {
+    if (auto it = code_.find(&function); it != code_.end()) {
+        return it->second != nullptr;
+    }
+    return std::nullopt;
+}
+
+Jit::TraceExit Jit::run(Trace& trace, Environment& env, size_t depth) {
+    trace.entries++;
+    // Type guards for the whole trace. The trace updates the variables in
+    // place as doubles, and those that held integers get them back after.
+    std::array<double*, maxVariables> variables;
+    std::array<Object*, maxVariables> integers;
+    size_t integerCount = 0;
+    bool numbers = true;
+    for (size_t i = 0; i < trace.variables.size() && numbers; i++) {
+        Object* object = env.findAt(trace.variables[i].distance, trace.variables[i].name);
+        if (auto* integer = object ? std::get_if<int64_t>(object) : nullptr) {
+            *object = static_cast<double>(*integer);
+            integers[integerCount++] = object;
+        }
+        variables[i] = object ? std::get_if<double>(object) : nullptr;
+        numbers = variables[i] != nullptr;
+    }
+    ScopeGuard restore{ [&] {
+        for (size_t i = 0; i < integerCount; i++) {
+            *integers[i] = number(std::get<double>(*integers[i]));
+        }
+    } };
+
+    if (numbers) {
+        JitContext context{ &env, &globals_, this, false, depth };
+        if ((*trace.code.machineCode)(&context, variables.data()) == 0) {
+            return TraceExit::Finished;
+        }
+        if (context.deopt) {
+            stats_.deopts++;
+        }
+    }
+
+    // Give up on loops that leave most of the times they enter.
+    stats_.sideExits++;
+    if (++trace.sideExits >= 64 && trace.sideExits * 4 > trace.entries * 3) {
+        trace.blacklisted = true;
+    }
+    return TraceExit::SideExit;
+}
+
+// Calls another function from native code. Only functions that run natively
+// themselves keep the call free of side effects.
+double Jit::callFromNative(JitContext* context, const CallSite* site, const double* arguments) {
+    Object* callee = lookUp(context, site->name);
+    auto* function = callee ? std::get_if<FunctionPtr>(callee) : nullptr;
+    if (!function || (*function)->arity() != site->arity || !(*function)->jittable_) {
+        context->deopt = true;
+        return 0;
+    }
+
+    // Too deep, the interpreter fails the call
+    if (context->depth == 0) {
+        context->deopt = true;
+        return 0;
+    }
+
+    Function& f = **function;
+    const MachineCode* code = f.machineCode_ ? f.machineCode_ : context->jit->compile(f);
+    if (!code) {
+        f.jittable_ = false;
+        context->deopt = true;
+        return 0;
+    }
+    JitContext inner{ f.closure_.get(), context->globals, context->jit, false, context->depth - 1 };
+    double result = (*code)(&inner, arguments);
+    if (inner.deopt) {
+        f.jittable_ = false;
+        context->deopt = true;
+    }
+    return result;
+}
+
+double Jit::loadFromNative(JitContext* context, const std::string* name, const double*) {
+    if (Object* object = lookUp(context, *name)) {
+        if (isNumber(*object)) {
+            return toDouble(*object);
+        }
+    }
+    context->deopt = true;
+    return 0;
+}
+
+// Variables from outside a function are either captured in its closure or
+// global.
+Object* Jit::lookUp(JitContext* context, const std::string& name) {
+    if (context->closure) {
+        if (Object* object = context->closure->lookUp(name)) {
+            return object;
+        }
+    }
+    return context->globals->lookUp(name);
+}
+
+} // cpplox
\ No newline at end of file
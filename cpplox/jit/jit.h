@@ -0,0 +1,174 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ast/statement.h>
+#include <env/env.h>
+#include <env/fwd.h>
+
+// The JIT emits x86-64 code for the System V ABI into mmap'd pages. Elsewhere
+// it rejects every function and they keep running in the interpreter.
+#if defined(__x86_64__) && defined(__linux__)
+#define CPPLOX_JIT_X64 1
+#endif
+
+namespace cpplox {
+
+// State of a native call, passed in rdi and kept in rbx
+struct JitContext {
+    Environment* closure;
+    Environment* globals;
+    class Jit* jit;
+    // Set when the code hit something it can't handle. Its result is then
+    // discarded and the call redone in the interpreter.
+    bool deopt;
+    // Calls the code may still nest, as the interpreter limits them
+    size_t depth;
+};
+
+// Executable code of one function or loop trace. Functions take their
+// arguments as doubles, traces a table of pointers to their variables.
+class MachineCode {
+public:
+    using Entry = double (*)(JitContext*, const void*);
+
+    MachineCode(const std::vector<uint8_t>& code);
+    ~MachineCode();
+
+    MachineCode(const MachineCode&) = delete;
+    MachineCode& operator=(const MachineCode&) = delete;
+
+    double operator()(JitContext* context, const void* arguments) const {
+        return entry_(context, arguments);
+    }
+
+    explicit operator bool() const {
+        return entry_ != nullptr;
+    }
+
+private:
+    void* memory_ = nullptr;
+    size_t size_ = 0;
+    Entry entry_ = nullptr;
+};
+
+// Baseline template JIT for numeric functions. A function qualifies when its
+// body only declares, reads and assigns its own locals and computes with
+// numbers, branches and loops, and calls other functions. Such code has no
+// side effects, so whenever a value turns out not to be a number the native
+// call bails out and the interpreter simply runs the call again.
+//
+// Hot loops are traced: the interpreter records which way every if of one
+// iteration went, and that path is compiled with the other directions as
+// side exits. A trace caches the variables of the loop's environment as
+// unboxed doubles, writing them through as it assigns them, and rolls them
+// back to the start of the iteration on a side exit. Since the iteration
+// then had no effect, the interpreter resumes it at the loop's body.
+class Jit {
+public:
+    struct Stats {
+        size_t compiled = 0;
+        size_t rejected = 0;
+        size_t deopts = 0;
+        size_t traces = 0;
+        size_t rejectedTraces = 0;
+        size_t sideExits = 0;
+    };
+
+    // Iterations of one run of a loop after which it gets traced
+    static constexpr size_t traceThreshold = 100;
+
+    // Direction each if took while an iteration was recorded
+    using Path = std::unordered_map<const IfStatement*, bool>;
+
+    enum class TraceExit { Finished, SideExit };
+
+    // A variable from outside the loop, `distance` environments above it
+    struct TraceVariable {
+        size_t distance;
+        std::string name;
+    };
+
+    explicit Jit(Environment& globals) : globals_(globals) {}
+
+    // Runs a hot function natively if it compiles and all arguments are
+    // numbers, or returns nothing if the interpreter has to run it. Calls
+    // nested more than `depth` deep, counting this one, are left to the
+    // interpreter, which fails them.
+    std::optional<Object> call(Function& function, const std::vector<Object>& arguments, size_t depth);
+
+    const Stats& stats() const {
+        return stats_;
+    }
+
+    struct Trace;
+
+    // Native code for a loop, or null if it has none or it was given up
+    Trace* trace(const WhileStatement& loop);
+
+    // Whether the loop was recorded already, successfully or not
+    bool traced(const WhileStatement& loop) const {
+        return traces_.contains(&loop);
+    }
+
+    void compileTrace(const WhileStatement& loop, const Path& path, const Interpreter& interpreter);
+
+    // Leaves the loop to the interpreter without recording it
+    void rejectTrace(const WhileStatement& loop) {
+        traces_[&loop];
+    }
+
+    // The path the loop's trace was compiled for, if it has a live one
+    const Path* tracePath(const WhileStatement& loop) const;
+
+    // Whether the function was compiled, or nothing if it never got hot
+    std::optional<bool> compiled(const FunctionStatement& function) const;
+
+    // Runs the loop natively from its condition on, in the environment the
+    // loop runs in. After a side exit the condition held and the body has to
+    // be run by the interpreter. The calls the loop makes nest at most
+    // `depth` deep, as in call().
+    TraceExit run(Trace& trace, Environment& env, size_t depth);
+
+    // Callee of a call from native code, and what the native code holds for it
+    struct CallSite {
+        std::string name;
+        size_t arity;
+    };
+
+    struct Code {
+        std::unique_ptr<MachineCode> machineCode;
+        std::vector<std::unique_ptr<CallSite>> callSites;
+        std::vector<std::unique_ptr<std::string>> names;
+    };
+
+    struct Trace {
+        Code code;
+        std::vector<TraceVariable> variables;
+        Path path;
+        size_t entries = 0;
+        size_t sideExits = 0;
+        // Set once the loop leaves its trace too often
+        bool blacklisted = false;
+    };
+
+private:
+    const MachineCode* compile(Function& function);
+    static double callFromNative(JitContext* context, const CallSite* site, const double* arguments);
+    static double loadFromNative(JitContext* context, const std::string* name, const double*);
+    static Object* lookUp(JitContext* context, const std::string& name);
+
+    Environment& globals_;
+    // Keyed by declaration, so closures and bound copies of a function share
+    // its code. Null if the function doesn't qualify.
+    std::unordered_map<const FunctionStatement*, std::unique_ptr<Code>> code_;
+    // Null if the loop doesn't qualify
+    std::unordered_map<const WhileStatement*, std::unique_ptr<Trace>> traces_;
+    Stats stats_;
+};
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <string>
+
+#include <env/test/prepared.h>
+#include <jit/jit.h>
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace cpplox;
+
+namespace {
+
+// Runs the program as the driver does, returning what it printed
+std::string run(const std::string& program, Jit::Stats& stats) {
+    Prepared prepared(program);
+    prepared.optimize();
+    std::string out = prepared.run();
+    stats = prepared.interpreter.jit().stats();
+    return out;
+}
+
+}
+
+TEST_CASE("JitRecursion") {
+    Jit::Stats stats;
+    auto out = run(R"(
+        fun fib(n) {
+            if (n <= 1) return n;
+            return fib(n - 2) + fib(n - 1);
+        }
+        print fib(20);
+    )", stats);
+    REQUIRE(out == "6765\n");
+#ifdef CPPLOX_JIT_X64
+    REQUIRE(stats.compiled == 1);
+    REQUIRE(stats.deopts == 0);
+#else
+    REQUIRE(stats.compiled == 0);
+#endif
+}
+
+TEST_CASE("JitLoops") {
+    Jit::Stats stats;
+    auto out = run(R"(
+        var scale = 2;
+        fun kernel(n) {
+            var sum = 0;
+            for (var i = 0; i < n; i = i + 1) {
+                if (i == 3 or !(i != 5)) {
+                    sum = sum - i / 2;
+                } else if (i >= 7 and i <= 8) {
+                    sum = sum + -i;
+                } else {
+                    sum = sum + i * scale;
+                }
+            }
+            return sum;
+        }
+        var total = 0;
+        for (var k = 0; k < 100; k = k + 1) {
+            total = total + kernel(k);
+        }
+        print total;
+        print kernel(10);
+    )", stats);
+    REQUIRE(out == "317389\n25\n");
+#ifdef CPPLOX_JIT_X64
+    REQUIRE(stats.compiled == 1);
+#endif
+}
+
+TEST_CASE("JitGuards") {
+    Jit::Stats stats;
+    auto out = run(R"(
+        fun add(a, b) {
+            return a + b;
+        }
+        fun say(a) {
+            print a;
+            return a;
+        }
+        fun twice(a) {
+            return say(a) + say(a);
+        }
+        var sum = 0;
+        for (var i = 0; i < 60; i = i + 1) {
+            sum = add(sum, i);
+        }
+        print sum;
+        print add("a", "b");
+        for (var i = 0; i < 51; i = i + 1) {
+            twice(1);
+        }
+        print twice(2);
+    )", stats);
+    std::string expected = "1770\n\"ab\"\n";
+    for (int i = 0; i < 51 * 2; i++) {
+        expected += "1\n";
+    }
+    expected += "2\n2\n4\n";
+    REQUIRE(out == expected);
+#ifdef CPPLOX_JIT_X64
+    // say prints, and twice can't call it natively
+    REQUIRE(stats.compiled == 2);
+    REQUIRE(stats.rejected == 1);
+    REQUIRE(stats.deopts == 1);
+#endif
+}
+
+TEST_CASE("JitTraces") {
+    Jit::Stats stats;
+    auto out = run(R"(
+        var sum = 0;
+        for (var i = 0; i < 1000; i = i + 1) {
+            var k = 2 * 3;
+            if (i < 500) {
+                sum = sum + k;
+            } else {
+                sum = sum - 1;
+            }
+        }
+        print sum;
+        var total = 0;
+        fun peek() {
+            return total;
+        }
+        var seen = 0;
+        for (var i = 0; i < 400; i = i + 1) {
+            total = total + 1;
+            seen = seen + peek();
+        }
+        print seen;
+        var count = 0;
+        for (var i = 0; i < 120; i = i + 1) {
+            for (var j = 0; j < 120; j = j + 1) {
+                if (j < i) count = count + 1;
+            }
+        }
+        print count;
+    )", stats);
+    REQUIRE(out == "2500\n80200\n7140\n");
+#ifdef CPPLOX_JIT_X64
+    // The outer of the nested loops isn't traced.
+    REQUIRE(stats.traces == 3);
+    REQUIRE(stats.rejectedTraces == 1);
+    REQUIRE(stats.sideExits > 0);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include <profile/profile.h>
+
+#include <algorithm>
+#include <format>
+#include <print>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+#include <variant>
+
+#include <ast/walk.h>
+
+namespace cpplox {
+
+namespace {
+
+template <typename T>
+constexpr bool is_specialized_v = std::is_same_v<T, BinaryExpr> || std::is_same_v<T, UnaryExpr>
+    || std::is_same_v<T, GetExpr> || std::is_same_v<T, InvokeExpr>;
+
+// FNV-1a
+uint64_t hash(std::string_view source) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : source) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    }
+    return hash;
+}
+
+constexpr std::string_view specializations[] = { "uninitialized", "number", "string", "monomorphic", "generic", "proven" };
+
+} // namespace
+
+Profile Profile::record(const std::vector<Statement>& stmts, const Interpreter& interpreter, std::string_view source) {
+    Profile profile;
+    profile.hash_ = hash(source);
+    const Jit& jit = interpreter.jit();
+    std::unordered_map<const IfStatement*, size_t> branches;
+    std::vector<std::pair<size_t, const WhileStatement*>> loops;
+    walk(stmts, [&](size_t site, const auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (std::is_same_v<T, GetExpr> || std::is_same_v<T, InvokeExpr>) {
+            // A monomorphic cache holds its class, which doesn't outlive the run
+            if (node.specialization == Specialization::Generic) {
+                profile.specializations_[site] = node.specialization;
+            }
+        } else if constexpr (is_specialized_v<T>) {
+            // Proven sites are proven again on every run
+            if (node.specialization != Specialization::Uninitialized && node.specialization != Specialization::Proven) {
+                profile.specializations_[site] = node.specialization;
+            }
+        } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+            FunctionProfile function{ interpreter.tiering() && interpreter.tiering()->requested(node), jit.compiled(node) };
+            if (function.tiered || function.compiled.has_value()) {
+                profile.functions_[site] = function;
+            }
+        } else if constexpr (std::is_same_v<T, IfStatement>) {
+            branches[&node] = site;
+        } else if constexpr (std::is_same_v<T, WhileStatement>) {
+            if (jit.traced(node)) {
+                loops.emplace_back(site, &node);
+            }
+        }
+    });
+
+    // The ifs of a path may come after the loop, in a function it calls
+    for (const auto& [site, loop] : loops) {
+        const Jit::Path* path = jit.tracePath(*loop);
+        if (!path) {
+            profile.loops_[site] = std::nullopt;
+            continue;
+        }
+        std::vector<std::pair<size_t, bool>> directions;
+        for (const auto& [branch, taken] : *path) {
+            directions.emplace_back(branches.at(branch), taken);
+        }
+        std::ranges::sort(directions);
+        profile.loops_[site] = std::move(directions);
+    }
+    return profile;
+}
+
+// One line per site, after a header with the version and the source's hash:
+//
+//   cpplox-profile 1 10118474291326395283
+//   12 spec number
+//   40 function tiered jit
+//   57 loop trace 61:1 70:0
+//   88 loop rejected
+std::optional<Profile> Profile::load(std::istream& in, std::string_view source, std::string& error) {
+    std::string magic;
+    uint32_t fileVersion = 0;
+    Profile profile;
+    if (!(in >> magic >> fileVersion >> profile.hash_) || magic != "cpplox-profile") {
+        error = "not a profile";
+        return std::nullopt;
+    }
+    if (fileVersion != version) {
+        error = std::format("profile has version {}, expected {}", fileVersion, version);
+        return std::nullopt;
+    }
+    if (profile.hash_ != hash(source)) {
+        error = "profile was recorded for a different source";
+        return std::nullopt;
+    }
+
+    std::string line;
+    std::getline(in, line);
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        size_t site = 0;
+        std::string kind;
+        if (!(fields >> site >> kind)) {
+            continue;
+        }
+        std::string field;
+        if (kind == "spec") {
+            fields >> field;
+            auto it = std::ranges::find(specializations, field);
+            // Only type inference proves sites
+            if (it == std::end(specializations) || it == std::begin(specializations) || *it == "proven") {
+                error = std::format("unknown specialization '{}'", field);
+                return std::nullopt;
+            }
+            profile.specializations_[site] = static_cast<Specialization>(it - std::begin(specializations));
+        } else if (kind == "function") {
+            FunctionProfile& function = profile.functions_[site];
+            while (fields >> field) {
+                if (field == "tiered") {
+                    function.tiered = true;
+                } else {
+                    function.compiled = field == "jit";
+                }
+            }
+        } else if (kind == "loop") {
+            fields >> field;
+            LoopProfile& loop = profile.loops_[site];
+            if (field == "rejected") {
+                continue;
+            }
+            loop.emplace();
+            size_t branch = 0;
+            char colon = 0;
+            bool taken = false;
+            while (fields >> branch >> colon >> taken) {
+                loop->emplace_back(branch, taken);
+            }
+        } else {
+            error = std::format("unknown site kind '{}'", kind);
+            return std::nullopt;
+        }
+    }
+    return profile;
+}
+
+void Profile::save(std::ostream& out) const {
+    std::print(out, "cpplox-profile {} {}\n", version, hash_);
+    for (const auto& [site, specialization] : specializations_) {
+        std::print(out, "{} spec {}\n", site, specializations[static_cast<size_t>(specialization)]);
+    }
+    for (const auto& [site, function] : functions_) {
+        std::print(out, "{} function", site);
+        if (function.tiered) {
+            std::print(out, " tiered");
+        }
+        if (function.compiled.has_value()) {
+            std::print(out, " {}", *function.compiled ? "jit" : "no-jit");
+        }
+        std::print(out, "\n");
+    }
+    for (const auto& [site, loop] : loops_) {
+        if (!loop.has_value()) {
+            std::print(out, "{} loop rejected\n", site);
+            continue;
+        }
+        std::print(out, "{} loop trace", site);
+        for (const auto& [branch, taken] : *loop) {
+            std::print(out, " {}:{}", branch, taken ? 1 : 0);
+        }
+        std::print(out, "\n");
+    }
+}
+
+void Profile::apply(const std::vector<Statement>& stmts, Interpreter& interpreter) const {
+    std::unordered_map<size_t, const IfStatement*> branches;
+    std::vector<std::pair<const WhileStatement*, const LoopProfile*>> loops;
+    walk(stmts, [&](size_t site, const auto& node) {
+        using T = std::decay_t<decltype(node)>;
+        if constexpr (is_specialized_v<T>) {
+            auto it = specializations_.find(site);
+            if (it != specializations_.end() && node.specialization == Specialization::Uninitialized) {
+                node.specialization = it->second;
+            }
+        } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+            if (auto it = functions_.find(site); it != functions_.end()) {
+                interpreter.warmUp(node, it->second);
+            }
+        } else if constexpr (std::is_same_v<T, IfStatement>) {
+            branches[site] = &node;
+        } else if constexpr (std::is_same_v<T, WhileStatement>) {
+            if (auto it = loops_.find(site); it != loops_.end()) {
+                loops.emplace_back(&node, &it->second);
+            }
+        }
+    });
+
+    for (const auto& [loop, profile] : loops) {
+        if (!profile->has_value()) {
+            interpreter.warmUp(*loop, nullptr);
+            continue;
+        }
+        Jit::Path path;
+        for (const auto& [site, taken] : **profile) {
+            if (auto it = branches.find(site); it != branches.end()) {
+                path[it->second] = taken;
+            }
+        }
+        interpreter.warmUp(*loop, &path);
+    }
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <ast/expr.h>
+#include <ast/statement.h>
+#include <env/interpreter.h>
+
+namespace cpplox {
+
+// Type feedback of one run of a program, saved so that the next run of the
+// same source starts warm instead of re-learning it. Sites are numbered by a
+// pre-order walk of the resolved and optimized AST, which comes out the same
+// for the same source on every run.
+//
+// A profile holds what operators specialized to, which property and method
+// sites went megamorphic, which functions got hot enough to tier up or be
+// compiled by the JIT, and the way every if of a traced loop went. Monomorphic
+// caches point at live classes, so those still fill on their first use.
+class Profile {
+public:
+    // Bumped whenever the format changes
+    static constexpr uint32_t version = 1;
+
+    // The path a loop was traced on as if-sites and directions, or nothing
+    // if the JIT gave the loop up
+    using LoopProfile = std::optional<std::vector<std::pair<size_t, bool>>>;
+
+    // The feedback `interpreter` gathered while running `stmts`, parsed from
+    // `source`
+    static Profile record(const std::vector<Statement>& stmts, const Interpreter& interpreter, std::string_view source);
+
+    // Reads a profile, or returns nothing with the reason in `error` if it is
+    // malformed or was recorded by another version or for another source
+    static std::optional<Profile> load(std::istream& in, std::string_view source, std::string& error);
+    void save(std::ostream& out) const;
+
+    // Seeds the nodes, functions and loops of `stmts` before they run
+    void apply(const std::vector<Statement>& stmts, Interpreter& interpreter) const;
+
+    // Number of sites with feedback
+    size_t size() const {
+        return specializations_.size() + functions_.size() + loops_.size();
+    }
+
+private:
+    uint64_t hash_ = 0;
+    std::map<size_t, Specialization> specializations_;
+    std::map<size_t, FunctionProfile> functions_;
+    std::map<size_t, LoopProfile> loops_;
+};
+
+} // cpplox
\ No newline at end of file
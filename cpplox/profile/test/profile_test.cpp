@@ -0,0 +1,104 @@
+#include <filesystem>
+#include <sstream>
+#include <string>
+
+#include <driver/driver.h>
+#include <env/test/prepared.h>
+#include <profile/profile.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+using namespace cpplox;
+
+namespace {
+
+const std::string program = R"(
+    fun square(n) {
+        return n * n;
+    }
+    var sum = 0;
+    for (var i = 0; i < 1000; i = i + 1) {
+        if (i < 50) {
+            sum = sum + 2;
+        } else {
+            sum = sum - 1;
+        }
+    }
+    for (var i = 0; i < 60; i = i + 1) {
+        sum = sum + square(i);
+    }
+    print sum;
+    print "a" + "b";
+)";
+
+}
+
+TEST_CASE("ProfileWarmStart") {
+    std::stringstream saved;
+    {
+        Prepared cold(program);
+        cold.optimize();
+        cold.run();
+        Profile::record(cold.stmts, cold.interpreter, program).save(saved);
+    }
+
+    std::string error;
+    auto profile = Profile::load(saved, program, error);
+    REQUIRE(profile.has_value());
+    REQUIRE(profile->size() > 0);
+
+    Prepared warm(program);
+    warm.optimize();
+    profile->apply(warm.stmts, warm.interpreter);
+    // The first loop's trace and the operators' handlers are in place
+    // before anything ran
+    const auto& loop = std::get<WhileStatement>(std::get<BlockStatement>(warm.stmts[2]).statements[1]);
+    REQUIRE(std::get<BinaryExpr>(loop.condition).specialization == Specialization::Number);
+    REQUIRE(warm.interpreter.jit().traced(loop));
+#ifdef CPPLOX_JIT_X64
+    REQUIRE(warm.interpreter.jit().stats().traces == 1);
+#endif
+
+    REQUIRE(warm.run() == "69360\n\"ab\"\n");
+#ifdef CPPLOX_JIT_X64
+    // square() went straight to the JIT
+    REQUIRE(warm.interpreter.jit().stats().compiled == 1);
+#endif
+}
+
+TEST_CASE("ProfileOfOtherSource") {
+    std::stringstream saved;
+    {
+        Prepared cold(program);
+        cold.optimize();
+        cold.run();
+        Profile::record(cold.stmts, cold.interpreter, program).save(saved);
+    }
+    std::string error;
+    REQUIRE(!Profile::load(saved, program + "print 1;", error).has_value());
+    REQUIRE(error == "profile was recorded for a different source");
+
+    std::stringstream stale("cpplox-profile 0 0\n");
+    REQUIRE(!Profile::load(stale, program, error).has_value());
+    REQUIRE(error.starts_with("profile has version 0"));
+}
+
+TEST_CASE("ProfileSamples") {
+    Engine engine = GENERATE(Engine::TreeWalk, Engine::Closure, Engine::Tiered);
+    auto path = std::filesystem::temp_directory_path() / "cpplox_profile_test.profile";
+    for (const auto& entry : std::filesystem::directory_iterator(SAMPLE_DIR)) {
+        INFO(entry.path().filename().string());
+        std::stringstream cold;
+        InterpreterDriver recorder(cold, engine);
+        recorder.saveProfile(path);
+        recorder.runScript(entry.path());
+
+        std::stringstream warm;
+        InterpreterDriver driver(warm, engine);
+        driver.loadProfile(path);
+        driver.runScript(entry.path());
+        CHECK(warm.str() == cold.str());
+    }
+    std::filesystem::remove(path);
+}
\ No newline at end of file
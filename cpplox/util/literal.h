@@ -0,0 +1,37 @@
+#pragma once
+
+#include <charconv>
+#include <format>
+#include <iterator>
+#include <string>
+
+namespace cpplox {
+
+// C++ source for a string, with everything but printable ASCII escaped
+inline std::string cppString(const std::string& s) {
+    std::string quoted = "\"";
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c >= 0x20 && c < 0x7F) {
+            quoted += c;
+        } else {
+            quoted += std::format("\\{}{}{}", c >> 6, (c >> 3) & 7, c & 7);
+        }
+    }
+    return quoted + "\"";
+}
+
+// The shortest C++ literal that reads back as the same double
+inline std::string cppNumber(double value) {
+    char buffer[64];
+    auto [end, ec] = std::to_chars(std::begin(buffer), std::end(buffer), value);
+    std::string literal(buffer, end);
+    if (literal.find_first_of(".e") == std::string::npos) {
+        literal += ".0";
+    }
+    return literal;
+}
+
+} // cpplox
\ No newline at end of file
@@ -0,0 +1,351 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace cpplox {
+
+class RefList;
+class ReleaseQueue;
+
+// Base of the objects a Ref shares, which keeps their reference count in the
+// object instead of a separate control block. The count isn't atomic: the
+// runtime objects of an interpreter never leave its thread. Anything that
+// does cross threads, such as the code Tiering compiles in the background,
+// is held by std::shared_ptr instead.
+//
+// The destructor is virtual so that the last Ref can free an object whose
+// type is incomplete where that happens.
+class RefCounted {
+public:
+    RefCounted() = default;
+    RefCounted(const RefCounted&) = delete;
+    RefCounted& operator=(const RefCounted&) = delete;
+
+    // For objects something other than their Refs owns, such as a static or
+    // an element of an array: the last Ref going away leaves them alone.
+    void pin() {
+        pinned_ = true;
+    }
+
+    using Visitor = std::function<void(RefCounted&)>;
+
+protected:
+    virtual ~RefCounted() = default;
+
+    // Called by the ReleaseQueue once the last Ref went away. An object may
+    // hand itself to a pool instead of being freed.
+    virtual void destroy() {
+        delete this;
+    }
+
+    // Visits every object this one holds a Ref to, once per Ref
+    virtual void traverse(const Visitor&) {}
+
+    // Visits every object this one keeps alive. More than traverse() for
+    // one that refers to a value without holding it.
+    virtual void reach(const Visitor& visit) {
+        traverse(visit);
+    }
+
+    // Drops the Refs this one holds that a Region frees on its own
+    virtual void detach() {}
+
+private:
+    // Joins the list current on the thread when the first Ref is made
+    void adopt();
+
+    void retain() {
+        refs_++;
+    }
+
+    void release();
+
+    uint32_t refs_ = 0;
+    bool pinned_ = false;
+    // The list the object was made in, if any
+    RefList* list_ = nullptr;
+    RefCounted* prev_ = nullptr;
+    RefCounted* next_ = nullptr;
+
+    template <typename T>
+    friend class Ref;
+    friend RefList;
+    friend ReleaseQueue;
+};
+
+// The objects made while the list is current on its thread, linked through
+// their headers, so joining and leaving it doesn't allocate. An object leaves
+// when it is destroyed. Subclasses get at the objects through the protected
+// helpers, as only the list itself is a friend of RefCounted.
+class RefList {
+public:
+    RefList() = default;
+    RefList(const RefList&) = delete;
+    RefList& operator=(const RefList&) = delete;
+
+    static RefList* current() {
+        return current_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+protected:
+    ~RefList() = default;
+
+    // Makes this the current list until leave(), returning the one it hides
+    RefList* enter() {
+        return std::exchange(current_, this);
+    }
+
+    static void leave(RefList* previous) {
+        current_ = previous;
+    }
+
+    void add(RefCounted& object) {
+        object.list_ = this;
+        object.prev_ = nullptr;
+        object.next_ = head_;
+        if (head_) {
+            head_->prev_ = &object;
+        }
+        head_ = &object;
+        size_++;
+    }
+
+    void remove(RefCounted& object) {
+        (object.prev_ ? object.prev_->next_ : head_) = object.next_;
+        if (object.next_) {
+            object.next_->prev_ = object.prev_;
+        }
+        object.list_ = nullptr;
+        object.prev_ = object.next_ = nullptr;
+        size_--;
+    }
+
+    template <typename F>
+    void forEach(F&& f) {
+        for (RefCounted* object = head_; object;) {
+            // f may remove the object
+            RefCounted* next = object->next_;
+            f(*object);
+            object = next;
+        }
+    }
+
+    bool contains(const RefCounted& object) const {
+        return object.list_ == this;
+    }
+
+    static uint32_t refs(const RefCounted& object) {
+        return object.refs_;
+    }
+
+    static void setPinned(RefCounted& object, bool pinned) {
+        object.pinned_ = pinned;
+    }
+
+    static void traverse(RefCounted& object, const RefCounted::Visitor& visit) {
+        object.traverse(visit);
+    }
+
+    static void reach(RefCounted& object, const RefCounted::Visitor& visit) {
+        object.reach(visit);
+    }
+
+    static void detach(RefCounted& object) {
+        object.detach();
+    }
+
+    static void destroy(RefCounted& object) {
+        object.destroy();
+    }
+
+private:
+    RefCounted* head_ = nullptr;
+    size_t size_ = 0;
+    static inline thread_local RefList* current_ = nullptr;
+
+    friend RefCounted;
+};
+
+// Objects whose last Ref went away, waiting to be destroyed. The objects one
+// releases while it is destroyed are queued in turn instead of destroyed from
+// inside its destructor, so freeing a long chain takes a loop rather than a
+// recursion as deep as the chain.
+//
+// Normally the release that starts it drains the queue before returning.
+// While releases are deferred, objects stay queued until drain() is called,
+// which spreads the destruction of a large graph over bounded slices.
+class ReleaseQueue {
+public:
+    // Objects destroyed per slice unless told otherwise
+    static constexpr size_t defaultSlice = 256;
+
+    // The queue of the thread, like the objects
+    static ReleaseQueue& instance() {
+        static thread_local ReleaseQueue queue;
+        return queue;
+    }
+
+    void push(RefCounted& object) {
+        queue_.push_back(&object);
+        if (deferrals_ == 0) {
+            drain();
+        }
+    }
+
+    // Destroys queued objects, and those they release, until none is left or
+    // `budget` were destroyed. Returns how many were.
+    size_t drain(size_t budget = SIZE_MAX) {
+        if (draining_) {
+            return 0;
+        }
+        draining_ = true;
+        size_t destroyed = 0;
+        // Last in first out, which keeps a chain at one queued object
+        while (!queue_.empty() && destroyed < budget) {
+            RefCounted* object = queue_.back();
+            queue_.pop_back();
+            object->destroy();
+            destroyed++;
+        }
+        draining_ = false;
+        return destroyed;
+    }
+
+    // Until as many resume() calls, releases leave objects queued
+    void defer() {
+        deferrals_++;
+    }
+
+    void resume() {
+        deferrals_--;
+    }
+
+    size_t size() const {
+        return queue_.size();
+    }
+
+private:
+    std::vector<RefCounted*> queue_;
+    size_t deferrals_ = 0;
+    bool draining_ = false;
+};
+
+inline void RefCounted::adopt() {
+    if (refs_++ == 0 && !pinned_ && !list_) {
+        if (RefList* list = RefList::current()) {
+            list->add(*this);
+        }
+    }
+}
+
+inline void RefCounted::release() {
+    if (--refs_ == 0 && !pinned_) {
+        if (list_) {
+            list_->remove(*this);
+        }
+        ReleaseQueue::instance().push(*this);
+    }
+}
+
+// Single-threaded, intrusive counterpart of std::shared_ptr for RefCounted
+// objects. Copies only bump the count in the object's header.
+template <typename T>
+class Ref {
+public:
+    Ref() = default;
+    Ref(std::nullptr_t) {}
+
+    // Shares an object created by makeRef(), or a pinned one
+    explicit Ref(T* object) : object_(object) {
+        if (object_) {
+            object_->adopt();
+        }
+    }
+
+    Ref(const Ref& other) : object_(other.object_) {
+        if (object_) {
+            object_->retain();
+        }
+    }
+
+    Ref(Ref&& other) noexcept : object_(std::exchange(other.object_, nullptr)) {}
+
+    Ref& operator=(const Ref& other) {
+        Ref(other).swap(*this);
+        return *this;
+    }
+
+    Ref& operator=(Ref&& other) noexcept {
+        Ref(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    ~Ref() {
+        if (object_) {
+            object_->release();
+        }
+    }
+
+    void swap(Ref& other) noexcept {
+        std::swap(object_, other.object_);
+    }
+
+    T* get() const {
+        return static_cast<T*>(object_);
+    }
+
+    // Doesn't need T to be complete
+    RefCounted* base() const {
+        return object_;
+    }
+
+    T& operator*() const {
+        return *get();
+    }
+
+    T* operator->() const {
+        return get();
+    }
+
+    size_t hash() const noexcept {
+        return std::hash<const void*>{}(object_);
+    }
+
+    explicit operator bool() const {
+        return object_ != nullptr;
+    }
+
+    friend bool operator==(const Ref& left, const Ref& right) {
+        return left.object_ == right.object_;
+    }
+
+    friend bool operator==(const Ref& ref, std::nullptr_t) {
+        return ref.object_ == nullptr;
+    }
+
+private:
+    // The base, so that copying and releasing don't need T to be complete
+    RefCounted* object_ = nullptr;
+};
+
+template <typename T, typename... Args>
+Ref<T> makeRef(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+} // cpplox
+
+template <typename T>
+struct std::hash<cpplox::Ref<T>> {
+    size_t operator()(const cpplox::Ref<T>& ref) const noexcept {
+        return ref.hash();
+    }
+};
\ No newline at end of file
@@ -1,12 +1,13 @@
 #pragma once
 
-#include <functional>
+#include <utility>
 
 namespace cpplox {
 
+template <typename F>
 class ScopeGuard {
 public:
-    explicit ScopeGuard(std::function<void()> guard) : guard_(std::move(guard)) {}
+    explicit ScopeGuard(F guard) : guard_(std::move(guard)) {}
 
     ~ScopeGuard() {
         guard_();
@@ -18,7 +19,7 @@ public:
     ScopeGuard& operator=(ScopeGuard&&) = delete;
 
 private:
-    std::function<void()> guard_;
+    F guard_;
 };
 
 } // cpplox
\ No newline at end of file
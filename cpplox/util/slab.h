@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace cpplox {
+
+// Storage for objects of one size, carved out of chunks that each hold
+// `chunkSize` of them next to each other. Allocating pops a freed slot, or
+// else bumps through the last chunk. Chunks are only given back when the
+// slab goes, which must be after every object in it.
+class Slab {
+public:
+    static constexpr size_t chunkSize = 64;
+
+    Slab(size_t size, size_t alignment) : alignment_(alignment), stride_((size + alignment - 1) / alignment * alignment) {}
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    ~Slab() {
+        for (std::byte* chunk : chunks_) {
+            ::operator delete(chunk, std::align_val_t(alignment_));
+        }
+    }
+
+    void* allocate() {
+        if (!free_.empty()) {
+            void* slot = free_.back();
+            free_.pop_back();
+            return slot;
+        }
+        if (used_ == chunkSize || chunks_.empty()) {
+            chunks_.push_back(static_cast<std::byte*>(::operator new(chunkSize * stride_, std::align_val_t(alignment_))));
+            used_ = 0;
+        }
+        return chunks_.back() + stride_ * used_++;
+    }
+
+    void deallocate(void* slot) {
+        free_.push_back(slot);
+    }
+
+private:
+    size_t alignment_;
+    size_t stride_;
+    std::vector<std::byte*> chunks_;
+    // Slots used in the last chunk
+    size_t used_ = 0;
+    std::vector<void*> free_;
+};
+
+} // cpplox
\ No newline at end of file
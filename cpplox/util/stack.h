@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+// AddressSanitizer has to be told about the switch, or it takes the other
+// stack for an overflow
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#define CPPLOX_ASAN_FIBERS 1
+#endif
+
+namespace cpplox {
+
+// A call stack allocated on the heap, for code that recurses deeper than the
+// thread's own stack allows. run() switches to it on the same thread, so
+// thread-local state carries over, and switches back once the function
+// returns. The memory is only reserved up front and committed as the stack
+// grows into it; a guard page at the end turns running off it into a fault
+// rather than a corruption.
+class Stack {
+public:
+    explicit Stack(size_t size) : size_(size + guardSize()) {
+        memory_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory_ == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        // Stacks grow down
+        mprotect(memory_, guardSize(), PROT_NONE);
+    }
+
+    ~Stack() {
+        munmap(memory_, size_);
+    }
+
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
+    // Lowest address of the stack, right above the guard page. Code running
+    // on it can check how close it got to running off it.
+    const void* bottom() const {
+        return static_cast<const char*>(memory_) + guardSize();
+    }
+
+    // Runs `f` on the stack. An exception it throws is rethrown here, once
+    // back on the caller's stack.
+    void run(const std::function<void()>& f) {
+        Call call{ f, {}, nullptr };
+        ucontext_t context;
+        getcontext(&context);
+        context.uc_stack.ss_sp = memory_;
+        context.uc_stack.ss_size = size_;
+        context.uc_link = &call.caller;
+        makecontext(&context, &Stack::enter, 0);
+        Call* outer = std::exchange(current_, &call);
+#ifdef CPPLOX_ASAN_FIBERS
+        void* fakeStack = nullptr;
+        __sanitizer_start_switch_fiber(&fakeStack, memory_, size_);
+#endif
+        swapcontext(&call.caller, &context);
+#ifdef CPPLOX_ASAN_FIBERS
+        __sanitizer_finish_switch_fiber(fakeStack, nullptr, nullptr);
+#endif
+        current_ = outer;
+        if (call.exception) {
+            std::rethrow_exception(call.exception);
+        }
+    }
+
+private:
+    struct Call {
+        const std::function<void()>& f;
+        ucontext_t caller;
+        std::exception_ptr exception;
+#ifdef CPPLOX_ASAN_FIBERS
+        const void* callerBottom = nullptr;
+        size_t callerSize = 0;
+#endif
+    };
+
+    static size_t guardSize() {
+        static const size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    // Unwinding can't cross back to the caller's stack, so nothing escapes
+    static void enter() {
+        Call* call = current_;
+#ifdef CPPLOX_ASAN_FIBERS
+        __sanitizer_finish_switch_fiber(nullptr, &call->callerBottom, &call->callerSize);
+#endif
+        try {
+            call->f();
+        } catch (...) {
+            call->exception = std::current_exception();
+        }
+#ifdef CPPLOX_ASAN_FIBERS
+        __sanitizer_start_switch_fiber(nullptr, call->callerBottom, call->callerSize);
+#endif
+    }
+
+    void* memory_;
+    size_t size_;
+    // The call being started, read by enter(), which takes no arguments
+    static inline thread_local Call* current_ = nullptr;
+};
+
+} // cpplox
\ No newline at end of file
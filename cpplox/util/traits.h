@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <type_traits>
 
 namespace cpplox {
@@ -16,4 +17,18 @@ struct is_contained_in<T, Container<Ts...>> : std::disjunction<std::is_same<T, T
 template <typename T, typename Container>
 constexpr bool is_contained_in_v = is_contained_in<T, Container>::value;
 
+template <typename T, typename Container>
+struct index_in;
+template <typename T, template <typename...> typename Container, typename... Ts>
+struct index_in<T, Container<Ts...>> {
+    static constexpr size_t value = [] {
+        size_t i = 0;
+        ((std::is_same_v<T, Ts> ? false : (++i, true)) && ...);
+        return i;
+    }();
+};
+// Position of T among the alternatives of a variant
+template <typename T, typename Container>
+constexpr size_t index_in_v = index_in<T, Container>::value;
+
 } // cpplox
\ No newline at end of file